@@ -2,14 +2,40 @@
 
 layout(binding = 1) uniform sampler2D tex_sampler;
 
-layout(location = 0) in vec2 uv;
+// built once per mesh pass, as is for the opaque faces, which never discard
+// so they keep early depth testing, with ALPHA_TESTED for the cutout faces
+// and with BLENDED for water
+
+#if defined(BLENDED)
+// water lets the faces behind it show through
+const float water_alpha = 0.7;
+#endif
+
+layout(location = 0) in vec3 local;
+layout(location = 1) flat in uint face;
+layout(location = 2) flat in vec2 tile;
 
 layout(location = 0) out vec4 color;
 
 void main()
 {
-   color = texture(tex_sampler, uv / 16);
+   // repeat the tile across merged faces, oriented like a single block face
+   vec2 uv;
+   switch (face) {
+   case 0u: uv = vec2(local.x, -local.z); break; // up
+   case 1u: uv = vec2(local.x, local.z); break;  // down
+   case 2u: uv = vec2(-local.z, local.y); break; // left
+   case 3u: uv = vec2(local.z, local.y); break;  // right
+   case 4u: uv = vec2(local.x, local.y); break;  // front
+   default: uv = vec2(-local.x, local.y); break; // back
+   }
+
+   color = texture(tex_sampler, (tile + fract(uv)) / 16);
+#if defined(ALPHA_TESTED)
    if (color.w == 0) {
      discard;
    }
+#elif defined(BLENDED)
+   color.w *= water_alpha;
+#endif
 }
\ No newline at end of file
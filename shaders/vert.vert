@@ -4,20 +4,64 @@ layout(binding = 0) uniform Uniform {
   mat4 view_proj;
 } ubo;
 
-layout(push_constant) uniform Push {
-  vec3 offset;
-} push;
+// written by World::cull, each draw uses its chunk slot as instance index
+struct Chunk {
+  vec4 origin;
+  vec4 aabb_min;
+  vec4 aabb_max;
+  uint first_vertex;
+  // opaque, cutout and water, one pass after another
+  uint vertex_counts[3];
+  uint water_rank;
+};
 
+layout(std430, binding = 3) readonly buffer Chunks {
+  Chunk chunks[];
+};
+
+#ifdef VERTEX_PULLING
+// one word per face, the six vertices of a face read the same word
+layout(std430, binding = 2) readonly buffer Faces {
+  uint faces[];
+};
+
+// the corners of each face in the order get_quad emits them
+const vec3 corners[6][4] = vec3[6][4](
+  vec3[4](vec3(0, 0, 1), vec3(0, 0, 0), vec3(1, 0, 0), vec3(1, 0, 1)),
+  vec3[4](vec3(0, 1, 0), vec3(0, 1, 1), vec3(1, 1, 1), vec3(1, 1, 0)),
+  vec3[4](vec3(0, 0, 1), vec3(0, 1, 1), vec3(0, 1, 0), vec3(0, 0, 0)),
+  vec3[4](vec3(1, 0, 0), vec3(1, 1, 0), vec3(1, 1, 1), vec3(1, 0, 1)),
+  vec3[4](vec3(0, 0, 0), vec3(0, 1, 0), vec3(1, 1, 0), vec3(1, 0, 0)),
+  vec3[4](vec3(1, 0, 1), vec3(1, 1, 1), vec3(0, 1, 1), vec3(0, 0, 1)));
+const uint quad[6] = uint[6](0u, 1u, 2u, 2u, 3u, 0u);
+#else
 layout(location = 0) in uint data;
+#endif
 
-layout(location = 0) out vec2 uv;
+layout(location = 0) out vec3 local;
+layout(location = 1) flat out uint face;
+layout(location = 2) flat out vec2 tile;
 
 void main()
 {
-  uv = vec2(data & 0xfu, (data >> 4) & 0xfu);
+#ifdef VERTEX_PULLING
+  uint data = faces[gl_VertexIndex / 6];
+  // a removed face is left as a hole of zero
+  if ((data & 0x800u) == 0u) {
+    gl_Position = vec4(0.0);
+    return;
+  }
+#endif
+  tile = vec2(data & 0xfu, (data >> 4) & 0xfu);
+  face = (data >> 8) & 0x7u;
 
   uint pos_y = (data >> 24) & 0xffu;
-  uint pos_x = (data >> 16) & 0xffu;
-  uint pos_z = (data >> 8) & 0xffu;
-  gl_Position = ubo.view_proj * vec4(vec3(pos_x, pos_y, pos_z) + push.offset, 1.0);
+  uint pos_x = (data >> 18) & 0x3fu;
+  uint pos_z = (data >> 12) & 0x3fu;
+  local = vec3(pos_x, pos_y, pos_z);
+#ifdef VERTEX_PULLING
+  local += corners[face][quad[gl_VertexIndex % 6]];
+#endif
+  vec3 origin = chunks[gl_InstanceIndex].origin.xyz;
+  gl_Position = ubo.view_proj * vec4(local + origin, 1.0);
 }
\ No newline at end of file
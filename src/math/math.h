@@ -6,6 +6,8 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include <array>
+
 template<typename T, typename U>
 constexpr T round_to(T x, U a) noexcept
 {
@@ -22,3 +24,21 @@ perspective(T fovy, T aspect, T near, T far)
   proj[1][1] *= -1;
   return proj;
 }
+
+// a point p is inside the frustum if dot(plane.xyz, p) + plane.w >= 0 for
+// every plane, the order is left, right, bottom, top, near, far
+template<typename T>
+constexpr std::array<glm::vec<4, T, glm::qualifier::defaultp>, 6>
+frustum_planes(glm::mat<4, 4, T, glm::qualifier::defaultp> const& m) noexcept
+{
+  auto const row{[&](int r) {
+    return glm::vec<4, T, glm::qualifier::defaultp>{
+        m[0][r], m[1][r], m[2][r], m[3][r]};
+  }};
+  return {row(3) + row(0),
+          row(3) - row(0),
+          row(3) + row(1),
+          row(3) - row(1),
+          row(2),
+          row(3) - row(2)};
+}
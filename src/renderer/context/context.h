@@ -20,6 +20,11 @@ public:
 
   vk::PhysicalDevice get_gpu() const noexcept { return device_.get_gpu(); }
 
+  bool has_transfer_family() const noexcept
+  {
+    return device_.has_transfer_family();
+  }
+
   template<QueueType Q>
   unsigned get_queue_family() const noexcept
   {
@@ -33,6 +38,8 @@ public:
       return graphics_queue_;
     else if constexpr (Q == QueueType::present)
       return present_queue_;
+    else if constexpr (Q == QueueType::transfer)
+      return transfer_queue_;
     else
       static_assert(std::is_same_v<Q, void*>);
   }
@@ -56,6 +63,9 @@ private:
   vk::Queue present_queue_{device_.get_device().getQueue(
       device_.get_queue_family<QueueType::present>(),
       0)};
+  vk::Queue transfer_queue_{device_.get_device().getQueue(
+      device_.get_queue_family<QueueType::transfer>(),
+      0)};
   vk::PhysicalDeviceProperties properties_{device_.get_gpu().getProperties()};
   vk::PhysicalDeviceMemoryProperties memory_properties{
       device_.get_gpu().getMemoryProperties()};
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cstring>
 #include <gsl/gsl>
+#include <span>
 #include <stdexcept>
 
 namespace {
@@ -13,6 +14,9 @@ namespace {
   bool has_device_extensions_support(vk::PhysicalDevice gpu,
                                      vk::SurfaceKHR surface) noexcept;
   bool has_device_features_support(vk::PhysicalDevice gpu) noexcept;
+  unsigned
+  find_transfer_family(std::span<vk::QueueFamilyProperties const> families,
+                       unsigned graphics) noexcept;
 } // namespace
 
 Device::Device(Instance const& instance)
@@ -27,6 +31,7 @@ Device::Device(Instance const& instance)
                            .pQueuePriorities{&queue_priority}});
 
   vk::DeviceCreateInfo info{
+      .pNext{&enabled_vulkan12_features},
       .queueCreateInfoCount{gsl::narrow<unsigned>(std::size(queue_infos))},
       .pQueueCreateInfos{queue_infos.data()},
       .enabledExtensionCount{
@@ -92,18 +97,23 @@ void Device::select_gpu_and_queue_families(Instance const& instance)
     if (!std::size(graphics_candidates))
       continue;
 
+    auto const select{[&](unsigned graphics, unsigned present) {
+      gpu_ = i;
+      auto const transfer{::find_transfer_family(families, graphics)};
+      families_ = {graphics, present, transfer, {graphics}};
+      if (present != graphics)
+        families_.unique.push_back(present);
+      if (transfer != graphics)
+        families_.unique.push_back(transfer);
+    }};
     for (auto&& j : graphics_candidates)
       if (i.getSurfaceSupportKHR(j, surface.get_surface())) {
-        gpu_ = i;
-        families_ = {j, j, {j}};
+        select(j, j);
         return;
       }
     for (gsl::index j{0}; j < std::size(families); ++j)
       if (i.getSurfaceSupportKHR(j, surface.get_surface())) {
-        gpu_ = i;
-        families_ = {graphics_candidates[0],
-                     gsl::narrow<unsigned>(j),
-                     {graphics_candidates[0], gsl::narrow<unsigned>(j)}};
+        select(graphics_candidates[0], gsl::narrow<unsigned>(j));
         return;
       }
   }
@@ -156,7 +166,38 @@ namespace {
 
   bool has_device_features_support(vk::PhysicalDevice gpu) noexcept
   {
-    auto const features{gpu.getFeatures()};
-    return features.samplerAnisotropy;
+    if (gpu.getProperties().apiVersion < VK_API_VERSION_1_2)
+      return false;
+
+    vk::PhysicalDeviceVulkan12Features vulkan12_features{};
+    vk::PhysicalDeviceFeatures2 features{.pNext{&vulkan12_features}};
+    gpu.getFeatures2(&features);
+    return features.features.multiDrawIndirect
+        && features.features.drawIndirectFirstInstance
+        && features.features.samplerAnisotropy
+        && vulkan12_features.drawIndirectCount
+        && vulkan12_features.timelineSemaphore;
+  }
+
+  unsigned
+  find_transfer_family(std::span<vk::QueueFamilyProperties const> families,
+                       unsigned graphics) noexcept
+  {
+    // a family with transfer alone is usually a DMA engine that copies
+    // alongside rendering, a compute family is the next best thing
+    auto best{graphics};
+    auto best_rank{0};
+    for (gsl::index j{0}; j < std::ssize(families); ++j) {
+      auto const flags{families[j].queueFlags};
+      if (!(flags & vk::QueueFlagBits::eTransfer)
+          || flags & vk::QueueFlagBits::eGraphics)
+        continue;
+      if (auto const rank{flags & vk::QueueFlagBits::eCompute ? 1 : 2};
+          rank > best_rank) {
+        best = gsl::narrow<unsigned>(j);
+        best_rank = rank;
+      }
+    }
+    return best;
   }
 } // namespace
@@ -7,11 +7,14 @@
 #include <array>
 #include <span>
 
-enum class QueueType { graphics, present };
+enum class QueueType { graphics, present, transfer };
 
 struct QueueFamilies {
   unsigned graphics{};
   unsigned present{};
+  // a family made for copies if the device has one, the graphics family
+  // otherwise
+  unsigned transfer{};
   Vector<unsigned> unique{};
 };
 
@@ -27,8 +30,16 @@ public:
 #endif
 
   static constexpr vk::PhysicalDeviceFeatures enabled_device_features{
+      .multiDrawIndirect{VK_TRUE},
+      .drawIndirectFirstInstance{VK_TRUE},
       .samplerAnisotropy{VK_TRUE}};
 
+  // the culling pass decides how many chunks get drawn, and the frames wait
+  // for the uploads on the transfer queue with timeline semaphores
+  static constexpr vk::PhysicalDeviceVulkan12Features
+      enabled_vulkan12_features{.drawIndirectCount{VK_TRUE},
+                                .timelineSemaphore{VK_TRUE}};
+
   explicit Device(Instance const& instnace);
   Device(Device const&) = delete;
   Device(Device&&) noexcept;
@@ -40,6 +51,13 @@ public:
 
   vk::PhysicalDevice get_gpu() const noexcept { return gpu_; }
 
+  // whether the transfer queue is a family of its own, buffers it writes then
+  // change hands with queue family ownership transfers
+  bool has_transfer_family() const noexcept
+  {
+    return families_.transfer != families_.graphics;
+  }
+
   template<QueueType Q>
   unsigned get_queue_family() const noexcept
   {
@@ -47,6 +65,8 @@ public:
       return families_.graphics;
     else if constexpr (Q == QueueType::present)
       return families_.present;
+    else if constexpr (Q == QueueType::transfer)
+      return families_.transfer;
     else
       static_assert(std::is_same_v<Q, void*>);
   }
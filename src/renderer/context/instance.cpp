@@ -54,7 +54,7 @@ Instance::Instance()
       .applicationVersion{VK_MAKE_API_VERSION(1, 0, 0, 0)},
       .pEngineName{""},
       .engineVersion{VK_MAKE_API_VERSION(1, 0, 0, 0)},
-      .apiVersion{VK_API_VERSION_1_0}};
+      .apiVersion{VK_API_VERSION_1_2}};
 
   Vector<char const*> extensions(
       std::begin(Swapchain::get_required_extensions()),
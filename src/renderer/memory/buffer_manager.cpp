@@ -2,9 +2,10 @@
 
 #include "math/math.h"
 
-#include <chrono>
+#include <algorithm>
 #include <gsl/gsl>
-#include <iostream>
+#include <map>
+#include <stdexcept>
 
 BufferManager::BufferManager(BufferManager&& x)
     : buffer_infos_{std::move(x.buffer_infos_)},
@@ -45,19 +46,10 @@ Buffer BufferManager::create(vk::BufferUsageFlags usage,
                              long long size,
                              long long block_size)
 {
-  for (gsl::index i{0}; i < std::size(buffer_infos_); ++i) {
-    auto&& [u, p, a, s, c, d]{buffer_infos_[i]};
-    if (auto r{round_to(size, a)}; usage == u && property == p && s + r <= c) {
-      s += r;
-      if (property & vk::MemoryPropertyFlagBits::eHostVisible) {
-        d = static_cast<char*>(d) + r;
-        return {buffers_[i], s - r, r, static_cast<char*>(d) - r};
-      }
-      else
-        return {buffers_[i], s - r, r, nullptr};
-    }
-  }
+  if (auto const buffer{try_create(usage, property, size)})
+    return *buffer;
 
+  block_size = std::max(block_size, size);
   buffers_.push_back(g_context.get_device().createBuffer(
       {.size{gsl::narrow<unsigned long long>(block_size)},
        .usage{usage},
@@ -65,44 +57,276 @@ Buffer BufferManager::create(vk::BufferUsageFlags usage,
 
   auto const requirement{
       g_context.get_device().getBufferMemoryRequirements(buffers_.back())};
-  memories_.push_back(g_context.get_device().allocateMemory(
-      {.allocationSize{requirement.size},
-       .memoryTypeIndex{[&]() -> unsigned {
-         for (auto i{0u};
-              i < g_context.get_gpu_memory_properties().memoryTypeCount;
-              ++i)
-           if (requirement.memoryTypeBits & 1 << i
-               && (g_context.get_gpu_memory_properties()
-                       .memoryTypes[i]
-                       .propertyFlags
-                   & property)
-                      == property)
-             return i;
-         throw std::runtime_error{"failed to find a suitable memory type"};
-       }()}}));
+  auto const memory_type{[&]() -> unsigned {
+    for (auto i{0u}; i < g_context.get_gpu_memory_properties().memoryTypeCount;
+         ++i)
+      if (requirement.memoryTypeBits & 1 << i
+          && (g_context.get_gpu_memory_properties().memoryTypes[i].propertyFlags
+              & property)
+                 == property)
+        return i;
+    g_context.get_device().destroyBuffer(buffers_.back());
+    buffers_.pop_back();
+    throw std::runtime_error{"failed to find a suitable memory type"};
+  }()};
+  // a block that gets no memory is dropped, so the caller can fall back to
+  // another property
+  try {
+    memories_.push_back(g_context.get_device().allocateMemory(
+        {.allocationSize{requirement.size}, .memoryTypeIndex{memory_type}}));
+  }
+  catch (...) {
+    g_context.get_device().destroyBuffer(buffers_.back());
+    buffers_.pop_back();
+    throw;
+  }
 
   g_context.get_device().bindBufferMemory(
       buffers_.back(), memories_.back(), 0);
 
-  if (auto aligned_size{round_to(size, requirement.alignment)};
-      property & vk::MemoryPropertyFlagBits::eHostVisible) {
-    auto data{g_context.get_device().mapMemory(
-        memories_.back(), 0ull, requirement.size)};
-    buffer_infos_.push_back({usage,
-                             property,
-                             gsl::narrow<long long>(requirement.alignment),
-                             aligned_size,
-                             block_size,
-                             static_cast<char*>(data) + aligned_size});
-    return {buffers_.back(), 0ll, size, data};
+  void* data{};
+  if (property & vk::MemoryPropertyFlagBits::eHostVisible)
+    data = g_context.get_device().mapMemory(
+        memories_.back(), 0ull, requirement.size);
+  buffer_infos_.push_back({});
+  auto& info{buffer_infos_.back()};
+  info.usage = usage;
+  info.property = property;
+  info.memory_type = memory_type;
+  info.alignment = gsl::narrow<long long>(requirement.alignment);
+  info.capacity = block_size;
+  info.data = data;
+  give_range(info, 0, block_size);
+
+  auto const offset{take_range(info, round_to(size, info.alignment))};
+  return get_buffer(std::ssize(buffer_infos_) - 1, *offset, size);
+}
+
+std::optional<Buffer> BufferManager::try_create(
+    vk::BufferUsageFlags usage,
+    vk::MemoryPropertyFlags property,
+    long long size)
+{
+  for (gsl::index i{0}; i < std::ssize(buffer_infos_); ++i)
+    if (auto& info{buffer_infos_[i]};
+        info.usage == usage && info.property == property)
+      if (auto const offset{take_range(info, round_to(size, info.alignment))})
+        return get_buffer(i, *offset, size);
+  return std::nullopt;
+}
+
+void BufferManager::free(Buffer const& buffer)
+{
+  auto const block{std::ranges::find(buffers_, buffer.handle)};
+  if (block == std::end(buffers_))
+    throw std::runtime_error{"freeing a buffer of another manager"};
+  auto& info{buffer_infos_[block - std::begin(buffers_)]};
+  auto const range{info.ranges.find(buffer.offset)};
+  if (range == std::end(info.ranges))
+    throw std::runtime_error{"freeing a range that is not in use"};
+  auto const size{range->second};
+  info.ranges.erase(range);
+  give_range(info, buffer.offset, size);
+}
+
+std::vector<std::pair<Buffer, Buffer>>
+BufferManager::defragment(vk::CommandBuffer command,
+                          vk::BufferUsageFlags usage,
+                          vk::MemoryPropertyFlags property,
+                          std::function<bool(Buffer const&)> const& can_move)
+{
+  // whatever used the blocks before is done with them first
+  command.pipelineBarrier(
+      vk::PipelineStageFlagBits::eAllCommands,
+      vk::PipelineStageFlagBits::eTransfer,
+      {},
+      {{.srcAccessMask{vk::AccessFlagBits::eMemoryWrite},
+        .dstAccessMask{vk::AccessFlagBits::eTransferRead
+                       | vk::AccessFlagBits::eTransferWrite}}},
+      {},
+      {});
+
+  std::vector<std::pair<Buffer, Buffer>> moves;
+  for (gsl::index i{0}; i < std::ssize(buffer_infos_); ++i) {
+    auto& info{buffer_infos_[i]};
+    if (info.usage != usage || info.property != property)
+      continue;
+
+    // the copies that touch none of the bytes written or read by the copies
+    // before them go in a single call, the others wait for a barrier
+    Vector<vk::BufferCopy> pending;
+    auto const flush{[&] {
+      if (std::empty(pending))
+        return;
+      command.copyBuffer(buffers_[i], buffers_[i], pending);
+      command.pipelineBarrier(
+          vk::PipelineStageFlagBits::eTransfer,
+          vk::PipelineStageFlagBits::eTransfer,
+          {},
+          {{.srcAccessMask{vk::AccessFlagBits::eTransferWrite},
+            .dstAccessMask{vk::AccessFlagBits::eTransferRead
+                           | vk::AccessFlagBits::eTransferWrite}}},
+          {},
+          {});
+      pending.clear();
+    }};
+    auto const copy{[&](long long src, long long dst, long long size) {
+      vk::BufferCopy const region{gsl::narrow<unsigned long long>(src),
+                                  gsl::narrow<unsigned long long>(dst),
+                                  gsl::narrow<unsigned long long>(size)};
+      // a copy waits if it reads what one before it writes, or writes what
+      // one before it reads or writes
+      auto const overlap{[](vk::DeviceSize a,
+                            vk::DeviceSize a_size,
+                            vk::DeviceSize b,
+                            vk::DeviceSize b_size) {
+        return a < b + b_size && b < a + a_size;
+      }};
+      if (std::ranges::any_of(pending, [&](vk::BufferCopy const& r) {
+            return overlap(r.dstOffset, r.size, region.srcOffset, region.size)
+                || overlap(r.dstOffset, r.size, region.dstOffset, region.size)
+                || overlap(r.srcOffset, r.size, region.dstOffset, region.size);
+          }))
+        flush();
+      pending.push_back(region);
+    }};
+
+    std::vector<std::pair<long long, long long>> ranges(
+        std::begin(info.ranges), std::end(info.ranges));
+    std::ranges::sort(ranges);
+
+    // a range that stays put is a wall the ranges after it slide up to
+    auto end{0ll};
+    for (auto&& [offset, size] : ranges) {
+      auto const from{get_buffer(i, offset, size)};
+      if (offset == end || !can_move(from)) {
+        end = offset + size;
+        continue;
+      }
+
+      if (offset - end >= size)
+        copy(offset, end, size);
+      else {
+        // a range overlapping its new place goes through a free range after
+        // it, nothing has moved there yet, and stays if there is none
+        auto const scratch{std::ranges::find_if(
+            info.free_ranges.lower_bound(offset + size),
+            std::end(info.free_ranges),
+            [&](auto const& r) { return r.second >= size; })};
+        if (scratch == std::end(info.free_ranges)) {
+          end = offset + size;
+          continue;
+        }
+        copy(offset, scratch->first, size);
+        copy(scratch->first, end, size);
+      }
+      moves.push_back({from, get_buffer(i, end, size)});
+      info.ranges.erase(offset);
+      info.ranges[end] = size;
+      end += size;
+    }
+    flush();
+
+    // the free ranges are the gaps left between the ranges
+    info.free_ranges.clear();
+    info.free_sizes.clear();
+    ranges.assign(std::begin(info.ranges), std::end(info.ranges));
+    std::ranges::sort(ranges);
+    auto last{0ll};
+    for (auto&& [offset, size] : ranges) {
+      if (offset != last)
+        give_range(info, last, offset - last);
+      last = offset + size;
+    }
+    if (last != info.capacity)
+      give_range(info, last, info.capacity - last);
+  }
+
+  command.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eAllCommands,
+      {},
+      {{.srcAccessMask{vk::AccessFlagBits::eTransferWrite},
+        .dstAccessMask{vk::AccessFlagBits::eMemoryRead
+                       | vk::AccessFlagBits::eMemoryWrite}}},
+      {},
+      {});
+  return moves;
+}
+
+std::vector<BufferManager::Stats> BufferManager::get_stats() const
+{
+  std::map<unsigned, std::pair<Stats, long long>> types;
+  for (auto&& info : buffer_infos_) {
+    auto& [stats, largest]{types[info.memory_type]};
+    stats.memory_type = info.memory_type;
+    stats.reserved += info.capacity;
+    for (auto&& [offset, size] : info.ranges)
+      stats.used += size;
+    if (!std::empty(info.free_sizes))
+      largest = std::max(largest, std::prev(std::end(info.free_sizes))->first);
+  }
+
+  std::vector<Stats> result;
+  for (auto&& [type, entry] : types) {
+    auto [stats, largest]{entry};
+    auto const free{stats.reserved - stats.used};
+    stats.fragmentation = free == 0 ? 0. : 1. - static_cast<double>(largest)
+                                                    / static_cast<double>(free);
+    result.push_back(stats);
+  }
+  return result;
+}
+
+std::optional<long long> BufferManager::take_range(BufferInfo& info,
+                                                   long long size)
+{
+  auto const it{info.free_sizes.lower_bound({size, 0})};
+  if (it == std::end(info.free_sizes))
+    return std::nullopt;
+
+  auto const [free_size, offset]{*it};
+  info.free_sizes.erase(it);
+  info.free_ranges.erase(offset);
+  if (free_size != size) {
+    info.free_ranges[offset + size] = free_size - size;
+    info.free_sizes.insert({free_size - size, offset + size});
   }
-  else {
-    buffer_infos_.push_back({usage,
-                             property,
-                             gsl::narrow<long long>(requirement.alignment),
-                             aligned_size,
-                             block_size,
-                             nullptr});
-    return {buffers_.back(), 0ll, size, nullptr};
+  info.ranges[offset] = size;
+  return offset;
+}
+
+void BufferManager::give_range(BufferInfo& info,
+                               long long offset,
+                               long long size)
+{
+  // merge with the free ranges right before and after
+  auto next{info.free_ranges.lower_bound(offset)};
+  if (next != std::begin(info.free_ranges)) {
+    if (auto const prev{std::prev(next)};
+        prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      info.free_sizes.erase({prev->second, prev->first});
+      info.free_ranges.erase(prev);
+    }
+  }
+  if (next != std::end(info.free_ranges) && offset + size == next->first) {
+    size += next->second;
+    info.free_sizes.erase({next->second, next->first});
+    info.free_ranges.erase(next);
   }
+  info.free_ranges[offset] = size;
+  info.free_sizes.insert({size, offset});
+}
+
+Buffer BufferManager::get_buffer(gsl::index block,
+                                 long long offset,
+                                 long long size) const noexcept
+{
+  auto const& info{buffer_infos_[block]};
+  return {buffers_[block],
+          offset,
+          size,
+          info.data ? static_cast<char*>(info.data) + offset : nullptr};
 }
@@ -1,9 +1,17 @@
 #pragma once
 
+#include "container/hash_map.h"
 #include "resource/buffer.h"
 
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
 #include <vector>
 
+// hands out ranges of a few large buffers, a range goes back to the free list
+// of its block with free and the blocks are kept until the manager dies
 class BufferManager {
 public:
   static constexpr long long default_block_size{1 << 24};
@@ -19,16 +27,58 @@ public:
                 vk::MemoryPropertyFlags property,
                 long long size = default_block_size,
                 long long block_size = default_block_size);
+
+  // a range of a block that exists already, empty if none has room
+  std::optional<Buffer> try_create(vk::BufferUsageFlags usage,
+                                   vk::MemoryPropertyFlags property,
+                                   long long size);
+
+  void free(Buffer const& buffer);
+
+  // slide the ranges can_move allows to the front of the blocks of usage and
+  // property, the copies are recorded into command and the blocks need the
+  // transfer usages, returns where every moved range was and is now
+  std::vector<std::pair<Buffer, Buffer>>
+  defragment(vk::CommandBuffer command,
+             vk::BufferUsageFlags usage,
+             vk::MemoryPropertyFlags property,
+             std::function<bool(Buffer const&)> const& can_move);
+
+  struct Stats {
+    unsigned memory_type;
+    long long used;
+    long long reserved;
+    // the share of the free bytes outside the largest free range
+    double fragmentation;
+  };
+
+  // one entry per memory type with a block
+  std::vector<Stats> get_stats() const;
 private:
   struct BufferInfo {
     vk::BufferUsageFlags usage;
     vk::MemoryPropertyFlags property;
+    unsigned memory_type;
     long long alignment;
-    long long used_size;
     long long capacity;
     void* data;
+    // the free ranges by offset to merge neighbours, and by size for the
+    // best fit
+    std::map<long long, long long> free_ranges;
+    std::set<std::pair<long long, long long>> free_sizes;
+    // the aligned size of every range handed out, by offset
+    HashMap<long long, long long> ranges;
   };
 
+  // take the smallest free range of size bytes or more
+  static std::optional<long long> take_range(BufferInfo& info, long long size);
+
+  static void give_range(BufferInfo& info, long long offset, long long size);
+
+  Buffer get_buffer(gsl::index block,
+                    long long offset,
+                    long long size) const noexcept;
+
   Vector<BufferInfo> buffer_infos_;
   Vector<vk::Buffer> buffers_;
   Vector<vk::DeviceMemory> memories_;
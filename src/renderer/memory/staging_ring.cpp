@@ -0,0 +1,77 @@
+#include "staging_ring.h"
+
+#include "math/math.h"
+
+#include <algorithm>
+
+StagingRing::StagingRing(long long size)
+    : buffer_{buffer_manager_.create(
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible
+            | vk::MemoryPropertyFlagBits::eHostCoherent,
+        round_to(size, alignment),
+        round_to(size, alignment))}
+{
+}
+
+std::optional<Buffer> StagingRing::allocate(long long size)
+{
+  auto const capacity{buffer_.size};
+  // an empty ring starts over at its front, so any size up to the capacity
+  // fits
+  if (allocated_ == released_)
+    allocated_ = released_ = round_to(allocated_, capacity);
+
+  // a range never wraps around, the end of the ring is skipped instead
+  auto const lap{allocated_ - allocated_ % capacity};
+  auto first{round_to(allocated_ % capacity, alignment)};
+  if (first + size > capacity)
+    first = capacity;
+  auto const begin{lap + first};
+  if (begin + size - released_ > capacity)
+    return std::nullopt;
+
+  allocated_ = begin + size;
+  peak_usage_ = std::max(peak_usage_, allocated_ - released_);
+  auto const offset{begin % capacity};
+  return Buffer{buffer_.handle,
+                buffer_.offset + offset,
+                size,
+                static_cast<char*>(buffer_.data) + offset};
+}
+
+long long StagingRing::get_available() const noexcept
+{
+  auto const capacity{buffer_.size};
+  if (allocated_ == released_)
+    return capacity;
+
+  // the rest of the current lap, then the front of the next one
+  auto const first{round_to(allocated_ % capacity, alignment)};
+  auto const lap{allocated_ - allocated_ % capacity};
+  auto const rest{
+      std::min(capacity - first, released_ + capacity - (lap + first))};
+  auto const front{released_ - lap};
+  return std::max({rest, front, 0ll});
+}
+
+void StagingRing::submit(vk::Semaphore timeline, uint64_t value)
+{
+  auto const last{std::empty(submissions_)
+                      ? released_
+                      : std::get<2>(submissions_.back())};
+  if (allocated_ != last)
+    submissions_.push_back({timeline, value, allocated_});
+}
+
+void StagingRing::reclaim()
+{
+  // a later submission of a faster queue waits behind the earlier ones
+  while (!std::empty(submissions_)) {
+    auto const [timeline, value, allocated]{submissions_.front()};
+    if (g_context.get_device().getSemaphoreCounterValue(timeline) < value)
+      break;
+    released_ = allocated;
+    submissions_.pop_front();
+  }
+}
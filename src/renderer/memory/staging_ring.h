@@ -0,0 +1,48 @@
+#pragma once
+
+#include "buffer_manager.h"
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <tuple>
+
+// a host visible buffer handed out front to back, a range is reused once the
+// submission it was recorded into has finished
+class StagingRing {
+public:
+  explicit StagingRing(long long size);
+
+  // a range of size bytes, empty while the ring is too full for it
+  std::optional<Buffer> allocate(long long size);
+
+  // the largest range allocate hands out right now
+  long long get_available() const noexcept;
+
+  // the ranges allocated since the last submit are released once the timeline
+  // semaphore reaches value, the submissions of several queues may share the
+  // ring as each one signals a timeline of its own
+  void submit(vk::Semaphore timeline, uint64_t value);
+
+  // release the ranges of the submissions the device has finished, in the
+  // order they were made
+  void reclaim();
+
+  long long size() const noexcept { return buffer_.size; }
+
+  // the most bytes in use at once since the start
+  long long get_peak_usage() const noexcept { return peak_usage_; }
+private:
+  static constexpr long long alignment{16};
+
+  BufferManager buffer_manager_{};
+  Buffer buffer_{};
+  // bytes handed out and released since the start, the ring is in use from
+  // released_ up to allocated_
+  long long allocated_{};
+  long long released_{};
+  long long peak_usage_{};
+  // the timeline and value of each submission in flight and allocated_ when
+  // it was made
+  std::deque<std::tuple<vk::Semaphore, uint64_t, long long>> submissions_{};
+};
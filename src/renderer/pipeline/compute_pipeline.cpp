@@ -0,0 +1,55 @@
+#include "compute_pipeline.h"
+
+ComputePipeline::ComputePipeline(vk::DescriptorSetLayout layout,
+                                 Code const& comp_code,
+                                 unsigned push_constant_size)
+{
+  vk::PushConstantRange const push_constant{
+      .stageFlags{vk::ShaderStageFlagBits::eCompute},
+      .size{push_constant_size}};
+  layout_ = g_context.get_device().createPipelineLayout(
+      {.setLayoutCount{1},
+       .pSetLayouts{&layout},
+       .pushConstantRangeCount{1},
+       .pPushConstantRanges{&push_constant}});
+
+  Shader const comp_shader{comp_code};
+  pipeline_ = g_context.get_device()
+                  .createComputePipeline(
+                      nullptr,
+                      {.stage{.stage{vk::ShaderStageFlagBits::eCompute},
+                              .module{comp_shader.get()},
+                              .pName{"main"}},
+                       .layout{layout_}})
+                  .value;
+}
+
+ComputePipeline::ComputePipeline(ComputePipeline&& x) noexcept
+    : layout_{x.layout_}, pipeline_{x.pipeline_}
+{
+  x.layout_ = nullptr;
+  x.pipeline_ = nullptr;
+}
+
+ComputePipeline& ComputePipeline::operator=(ComputePipeline&& x) noexcept
+{
+  if (pipeline_)
+    g_context.get_device().destroyPipeline(pipeline_);
+  pipeline_ = x.pipeline_;
+  x.pipeline_ = nullptr;
+
+  if (layout_)
+    g_context.get_device().destroyPipelineLayout(layout_);
+  layout_ = x.layout_;
+  x.layout_ = nullptr;
+
+  return *this;
+}
+
+ComputePipeline::~ComputePipeline()
+{
+  if (pipeline_)
+    g_context.get_device().destroyPipeline(pipeline_);
+  if (layout_)
+    g_context.get_device().destroyPipelineLayout(layout_);
+}
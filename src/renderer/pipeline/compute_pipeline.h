@@ -0,0 +1,25 @@
+#pragma once
+
+#include "core.h"
+
+#include "loader/code.h"
+#include "shader.h"
+
+class ComputePipeline {
+public:
+  ComputePipeline(vk::DescriptorSetLayout layout,
+                  Code const& comp_code,
+                  unsigned push_constant_size);
+  ComputePipeline(ComputePipeline const&) = delete;
+  ComputePipeline(ComputePipeline&&) noexcept;
+  ComputePipeline& operator=(ComputePipeline const&) = delete;
+  ComputePipeline& operator=(ComputePipeline&&) noexcept;
+  ~ComputePipeline();
+
+  vk::PipelineLayout get_layout() const noexcept { return layout_; }
+
+  vk::Pipeline get_pipeline() const noexcept { return pipeline_; }
+private:
+  vk::PipelineLayout layout_;
+  vk::Pipeline pipeline_;
+};
\ No newline at end of file
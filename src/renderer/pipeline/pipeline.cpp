@@ -8,17 +8,11 @@
 Pipeline::Pipeline(vk::RenderPass render_pass,
                    vk::DescriptorSetLayout layout,
                    Code const& vert_code,
-                   Code const& frag_code)
+                   Code const& frag_code,
+                   PipelineType type)
 {
-  constexpr vk::PushConstantRange push_constant{
-      .stageFlags{vk::ShaderStageFlagBits::eVertex
-                  | vk::ShaderStageFlagBits::eFragment},
-      .size{sizeof(PushConstant)}};
   layout_ = g_context.get_device().createPipelineLayout(
-      {.setLayoutCount{1},
-       .pSetLayouts{&layout},
-       .pushConstantRangeCount{1},
-       .pPushConstantRanges{&push_constant}});
+      {.setLayoutCount{1}, .pSetLayouts{&layout}});
 
   Shader const vert_shader{vert_code};
   vk::PipelineShaderStageCreateInfo const vert_stage{
@@ -32,6 +26,10 @@ Pipeline::Pipeline(vk::RenderPass render_pass,
       .pName{"main"}};
   std::array const stages{vert_stage, frag_stage};
 
+#if defined(CJCRAFT_VERTEX_PULLING)
+  // the vertex shader reads the faces from a storage buffer
+  constexpr vk::PipelineVertexInputStateCreateInfo vert_input{};
+#else
   constexpr auto binding_description{Vertex::get_binding_description()};
   constexpr auto attribute_descriptions{Vertex::get_attribute_description()};
   vk::PipelineVertexInputStateCreateInfo const vert_input{
@@ -39,6 +37,7 @@ Pipeline::Pipeline(vk::RenderPass render_pass,
       .pVertexBindingDescriptions{&binding_description},
       .vertexAttributeDescriptionCount{std::size(attribute_descriptions)},
       .pVertexAttributeDescriptions{attribute_descriptions.data()}};
+#endif
 
   constexpr vk::PipelineInputAssemblyStateCreateInfo input_assembly{
       .topology{vk::PrimitiveTopology::eTriangleList}};
@@ -51,11 +50,19 @@ Pipeline::Pipeline(vk::RenderPass render_pass,
       .lineWidth{1.0f}};
   constexpr vk::PipelineMultisampleStateCreateInfo multisampling{
       .rasterizationSamples{vk::SampleCountFlagBits::e1}};
-  constexpr vk::PipelineDepthStencilStateCreateInfo depth{
+  auto const blended{type == PipelineType::blended};
+  vk::PipelineDepthStencilStateCreateInfo const depth{
       .depthTestEnable{VK_TRUE},
-      .depthWriteEnable{VK_TRUE},
+      .depthWriteEnable{blended ? VK_FALSE : VK_TRUE},
       .depthCompareOp{vk::CompareOp::eLess}};
-  constexpr vk::PipelineColorBlendAttachmentState color_blend_attachment{
+  vk::PipelineColorBlendAttachmentState const color_blend_attachment{
+      .blendEnable{blended ? VK_TRUE : VK_FALSE},
+      .srcColorBlendFactor{vk::BlendFactor::eSrcAlpha},
+      .dstColorBlendFactor{vk::BlendFactor::eOneMinusSrcAlpha},
+      .colorBlendOp{vk::BlendOp::eAdd},
+      .srcAlphaBlendFactor{vk::BlendFactor::eOne},
+      .dstAlphaBlendFactor{vk::BlendFactor::eZero},
+      .alphaBlendOp{vk::BlendOp::eAdd},
       .colorWriteMask{
           vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
           | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA}};
@@ -7,12 +7,18 @@
 
 #include <vector>
 
+// opaque pipelines write depth, blended ones are drawn last over the others
+// without writing depth, each one takes the fragment shader variant of its
+// type
+enum class PipelineType { opaque, alpha_tested, blended };
+
 class Pipeline {
 public:
   Pipeline(vk::RenderPass render_pass,
            vk::DescriptorSetLayout layout,
            Code const& vert_code,
-           Code const& frag_code);
+           Code const& frag_code,
+           PipelineType type = PipelineType::opaque);
   Pipeline(Pipeline const&) = delete;
   Pipeline(Pipeline&&) noexcept;
   Pipeline& operator=(Pipeline const&) = delete;
@@ -3,9 +3,8 @@
 #include <array>
 #include <stdexcept>
 
-DescriptorSetLayout::DescriptorSetLayout()
-{
-  constexpr std::array<vk::DescriptorSetLayoutBinding, 2> bindings{
+namespace {
+  constexpr std::array<vk::DescriptorSetLayoutBinding, 4> draw_bindings{
       {{.binding{0},
 .descriptorType{vk::DescriptorType::eUniformBuffer},
 .descriptorCount{1},
@@ -15,9 +14,44 @@ DescriptorSetLayout::DescriptorSetLayout()
        .descriptorType{vk::DescriptorType::eCombinedImageSampler},
        .descriptorCount{1},
        .stageFlags{vk::ShaderStageFlagBits::eFragment},
+       },
+       {
+       .binding{2},
+       .descriptorType{vk::DescriptorType::eStorageBuffer},
+       .descriptorCount{1},
+       .stageFlags{vk::ShaderStageFlagBits::eVertex},
+       },
+       {
+       .binding{3},
+       .descriptorType{vk::DescriptorType::eStorageBuffer},
+       .descriptorCount{1},
+       .stageFlags{vk::ShaderStageFlagBits::eVertex},
        }}
   };
 
+  // chunk infos, draw commands and the draw count
+  constexpr std::array<vk::DescriptorSetLayoutBinding, 3> cull_bindings{
+      {{.binding{0},
+        .descriptorType{vk::DescriptorType::eStorageBuffer},
+        .descriptorCount{1},
+        .stageFlags{vk::ShaderStageFlagBits::eCompute}},
+       {.binding{1},
+        .descriptorType{vk::DescriptorType::eStorageBuffer},
+        .descriptorCount{1},
+        .stageFlags{vk::ShaderStageFlagBits::eCompute}},
+       {.binding{2},
+        .descriptorType{vk::DescriptorType::eStorageBuffer},
+        .descriptorCount{1},
+        .stageFlags{vk::ShaderStageFlagBits::eCompute}}}
+  };
+} // namespace
+
+DescriptorSetLayout::DescriptorSetLayout(DescriptorSetType type)
+{
+  std::span<vk::DescriptorSetLayoutBinding const> bindings{draw_bindings};
+  if (type == DescriptorSetType::cull)
+    bindings = cull_bindings;
+
   handle_ = g_context.get_device().createDescriptorSetLayout(
       {.bindingCount{gsl::narrow<unsigned>(std::size(bindings))},
        .pBindings{bindings.data()}});
@@ -47,14 +81,18 @@ DescriptorSetLayout::~DescriptorSetLayout()
 
 DescriptorPool::DescriptorPool()
 {
-  constexpr std::array<vk::DescriptorPoolSize, 2> sizes{
+  constexpr std::array<vk::DescriptorPoolSize, 3> sizes{
       {{.type{vk::DescriptorType::eUniformBuffer},
 .descriptorCount{gsl::narrow<unsigned>(max_in_flight)}},
        {.type{vk::DescriptorType::eCombinedImageSampler},
-       .descriptorCount{gsl::narrow<unsigned>(max_in_flight)}}}
+       .descriptorCount{gsl::narrow<unsigned>(max_in_flight)}},
+       // two in each draw set and three in each cull set
+       {.type{vk::DescriptorType::eStorageBuffer},
+       .descriptorCount{gsl::narrow<unsigned>(5 * max_in_flight)}}}
   };
+  // a draw set and a cull set per frame
   handle_ = g_context.get_device().createDescriptorPool(
-      {.maxSets{gsl::narrow<unsigned>(max_in_flight)},
+      {.maxSets{gsl::narrow<unsigned>(2 * max_in_flight)},
        .poolSizeCount{gsl::narrow<unsigned>(std::size(sizes))},
        .pPoolSizes{sizes.data()}});
 }
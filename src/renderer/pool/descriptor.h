@@ -5,9 +5,13 @@
 #include <gsl/gsl>
 #include <span>
 
+// draw sets feed the chunk pipeline, cull sets the chunk culling pass
+enum class DescriptorSetType { draw, cull };
+
 class DescriptorSetLayout {
 public:
-  DescriptorSetLayout();
+  explicit DescriptorSetLayout(
+      DescriptorSetType type = DescriptorSetType::draw);
   DescriptorSetLayout(DescriptorSetLayout const&) = delete;
   DescriptorSetLayout(DescriptorSetLayout&&) noexcept;
   DescriptorSetLayout& operator=(DescriptorSetLayout const&) = delete;
@@ -33,19 +37,28 @@ public:
   template<gsl::index N>
   std::array<vk::DescriptorSet, N>
   create_descriptor_sets(std::span<Buffer const, N> buffers,
+                         std::span<Buffer const, N> chunks,
                          vk::Sampler sampler,
                          vk::ImageView image_view,
-                         vk::DescriptorSetLayout layout) const;
+                         vk::DescriptorSetLayout layout,
+                         Buffer faces = {}) const;
+
+  // binds the storage buffers of each set to bindings 0 to M - 1
+  template<gsl::index N, gsl::index M>
+  std::array<vk::DescriptorSet, N> create_storage_descriptor_sets(
+      std::span<std::array<Buffer, M> const, N> buffers,
+      vk::DescriptorSetLayout layout) const;
 private:
+  template<gsl::index N>
+  std::array<vk::DescriptorSet, N>
+  allocate_descriptor_sets(vk::DescriptorSetLayout layout) const;
+
   vk::DescriptorPool handle_;
 };
 
 template<gsl::index N>
 std::array<vk::DescriptorSet, N>
-DescriptorPool::create_descriptor_sets(std::span<Buffer const, N> buffers,
-                                       vk::Sampler sampler,
-                                       vk::ImageView image_view,
-                                       vk::DescriptorSetLayout layout) const
+DescriptorPool::allocate_descriptor_sets(vk::DescriptorSetLayout layout) const
 {
   std::array<vk::DescriptorSetLayout, N> layouts;
   layouts.fill(layout);
@@ -58,6 +71,19 @@ DescriptorPool::create_descriptor_sets(std::span<Buffer const, N> buffers,
   if (g_context.get_device().allocateDescriptorSets(&info, sets.data())
       != vk::Result::eSuccess)
     throw std::runtime_error{"failed to allocate descriptor sets"};
+  return sets;
+}
+
+template<gsl::index N>
+std::array<vk::DescriptorSet, N>
+DescriptorPool::create_descriptor_sets(std::span<Buffer const, N> buffers,
+                                       std::span<Buffer const, N> chunks,
+                                       vk::Sampler sampler,
+                                       vk::ImageView image_view,
+                                       vk::DescriptorSetLayout layout,
+                                       Buffer faces) const
+{
+  auto const sets{allocate_descriptor_sets<N>(layout)};
 
   for (gsl::index i{0}; i < N; ++i) {
     vk::DescriptorBufferInfo const buffer_info{
@@ -68,8 +94,16 @@ DescriptorPool::create_descriptor_sets(std::span<Buffer const, N> buffers,
         .sampler{sampler},
         .imageView{image_view},
         .imageLayout{vk::ImageLayout::eShaderReadOnlyOptimal}};
+    vk::DescriptorBufferInfo const face_info{
+        .buffer{faces.handle},
+        .offset{gsl::narrow<unsigned long long>(faces.offset)},
+        .range{VK_WHOLE_SIZE}};
+    vk::DescriptorBufferInfo const chunk_info{
+        .buffer{chunks[i].handle},
+        .offset{gsl::narrow<unsigned long long>(chunks[i].offset)},
+        .range{gsl::narrow<unsigned long long>(chunks[i].size)}};
 
-    g_context.get_device().updateDescriptorSets(
+    std::array<vk::WriteDescriptorSet, 4> const writes{
         {
             {.dstSet{sets[i]},
              .dstBinding{0},
@@ -82,9 +116,52 @@ DescriptorPool::create_descriptor_sets(std::span<Buffer const, N> buffers,
              .dstArrayElement{0},
              .descriptorCount{1},
              .descriptorType{vk::DescriptorType::eCombinedImageSampler},
-             .pImageInfo{&image_info}  }
-    },
-        {});
+             .pImageInfo{&image_info}  },
+            {.dstSet{sets[i]},
+             .dstBinding{3},
+             .dstArrayElement{0},
+             .descriptorCount{1},
+             .descriptorType{vk::DescriptorType::eStorageBuffer},
+             .pBufferInfo{&chunk_info}  },
+            {.dstSet{sets[i]},
+             .dstBinding{2},
+             .dstArrayElement{0},
+             .descriptorCount{1},
+             .descriptorType{vk::DescriptorType::eStorageBuffer},
+             .pBufferInfo{&face_info}  }
+    }
+    };
+    // the face buffer is only bound when the chunks are pulled from it
+    g_context.get_device().updateDescriptorSets(
+        {faces.handle ? 4u : 3u, writes.data()}, {});
+  }
+
+  return sets;
+}
+
+template<gsl::index N, gsl::index M>
+std::array<vk::DescriptorSet, N> DescriptorPool::create_storage_descriptor_sets(
+    std::span<std::array<Buffer, M> const, N> buffers,
+    vk::DescriptorSetLayout layout) const
+{
+  auto const sets{allocate_descriptor_sets<N>(layout)};
+
+  for (gsl::index i{0}; i < N; ++i) {
+    std::array<vk::DescriptorBufferInfo, M> infos;
+    std::array<vk::WriteDescriptorSet, M> writes;
+    for (gsl::index j{0}; j < M; ++j) {
+      infos[j] = {
+          .buffer{buffers[i][j].handle},
+          .offset{gsl::narrow<unsigned long long>(buffers[i][j].offset)},
+          .range{gsl::narrow<unsigned long long>(buffers[i][j].size)}};
+      writes[j] = {.dstSet{sets[i]},
+                   .dstBinding{gsl::narrow<unsigned>(j)},
+                   .dstArrayElement{0},
+                   .descriptorCount{1},
+                   .descriptorType{vk::DescriptorType::eStorageBuffer},
+                   .pBufferInfo{&infos[j]}};
+    }
+    g_context.get_device().updateDescriptorSets(writes, {});
   }
 
   return sets;
@@ -4,6 +4,8 @@
 #include "math/math.h"
 #include "memory/buffer_manager.h"
 #include "memory/image_manager.h"
+#include "memory/staging_ring.h"
+#include "pipeline/compute_pipeline.h"
 #include "pipeline/framebuffer.h"
 #include "pipeline/pipeline.h"
 #include "pipeline/render_pass.h"
@@ -15,13 +17,17 @@
 #include "resource/sampler.h"
 #include "sync/fence.h"
 #include "sync/semaphore.h"
+#include "sync/timeline_semaphore.h"
 #include "world/chunk.h"
+#include "world/height_map_cache.h"
 #include "world/ray.h"
 #include "world/world.h"
 
 #include <array>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <span>
 
 constexpr vk::Extent2D default_extent{1'920, 1'080};
 
@@ -36,6 +42,27 @@ constexpr std::array item_list{BlockType::glass,
 
 constexpr auto gravity_constant{3.5f};
 
+// merge the faces of cold chunks into larger quads if CJCRAFT_GREEDY_MESHING
+// is set, a pulled face record has no room for the size of a merged quad
+#if defined(CJCRAFT_GREEDY_MESHING) && !defined(CJCRAFT_VERTEX_PULLING)
+constexpr auto greedy_meshing{true};
+#else
+constexpr auto greedy_meshing{false};
+#endif
+
+// voxels kept for the chunks the player touched, the least recently used go
+// first, a chunk only pays for the sections its surface passes through
+constexpr auto hot_terrain_memory{64ll << 20};
+
+// write edited chunk meshes straight into device memory where the device has
+// resizable BAR, they are copied from the staging ring without it or if this
+// is off
+constexpr auto direct_chunk_writes{true};
+
+// streamed meshes uploading at once on the transfer queue, each submission
+// holds its share of the staging ring until it completes
+constexpr auto max_uploads_in_flight{3};
+
 void draw()
 {
   std::ios::sync_with_stdio(false);
@@ -65,29 +92,57 @@ void draw()
   }
 
   DescriptorSetLayout descriptor_set_layout{};
-  Pipeline pipeline{render_pass.get(),
-                    descriptor_set_layout.get(),
-                    Code{"shaders/vert.spv"},
-                    Code{"shaders/frag.spv"}};
+  // one per mesh pass, in the order they are drawn
+  Code const vert_code{"shaders/vert.spv"};
+  std::array<Pipeline, nb_mesh_passes> pipelines{
+      Pipeline{render_pass.get(),
+               descriptor_set_layout.get(),
+               vert_code,
+               Code{"shaders/frag.spv"},
+               PipelineType::opaque},
+      Pipeline{render_pass.get(),
+               descriptor_set_layout.get(),
+               vert_code,
+               Code{"shaders/frag_alpha_tested.spv"},
+               PipelineType::alpha_tested},
+      Pipeline{render_pass.get(),
+               descriptor_set_layout.get(),
+               vert_code,
+               Code{"shaders/frag_blended.spv"},
+               PipelineType::blended}};
+
+  DescriptorSetLayout cull_set_layout{DescriptorSetType::cull};
+  ComputePipeline cull_pipeline{
+      cull_set_layout.get(), Code{"shaders/cull.spv"}, sizeof(CullConstant)};
 
   CommandPool<QueueType::graphics> command_pool{};
   DescriptorPool descriptor_pool{};
 
-  auto transfer_cmd{command_pool.create_command_buffers<1>()[0]};
-  Fence transfer_fence;
+  // the uploads signal upload_timeline with the count so far, and each frame
+  // waits for the last one before it reads the chunk meshes
+  CommandPool<QueueType::transfer> transfer_pool{};
+  auto transfer_cmds{
+      transfer_pool.create_command_buffers<max_uploads_in_flight>()};
+  TimelineSemaphore upload_timeline;
+  std::array<uint64_t, max_uploads_in_flight> upload_values{};
+  uint64_t upload_count{0};
+  gsl::index current_upload{0};
+  // the frames signal frame_timeline the same way, the staging ring holds
+  // the edits each one copies until it is done
+  TimelineSemaphore frame_timeline;
+  uint64_t frame_count{0};
+
+  // room for a full row of chunks per upload in flight, the peak printed at
+  // the end tells how much of it a render distance needs
+  StagingRing staging{
+      max_uploads_in_flight
+      * std::max(chunk_upload_budget, render_distance * chunk_buffer_size)};
+  World world{render_distance,
+              greedy_meshing,
+              hot_terrain_memory,
+              direct_chunk_writes};
 
   auto command{command_pool.begin_single_time_commands()};
-  BufferManager staging_manager;
-  auto const staging_buffer{
-      staging_manager.create(vk::BufferUsageFlagBits::eTransferSrc,
-                             vk::MemoryPropertyFlagBits::eHostVisible
-                                 | vk::MemoryPropertyFlagBits::eHostCoherent,
-                             2ll << 30,
-                             2ll << 30)};
-  World world{command, staging_buffer, render_distance};
-  command_pool.end_single_time_commands(command);
-
-  command = command_pool.begin_single_time_commands();
 
   BufferManager buffer_manager;
   std::array<Buffer, max_in_flight> uniform_buffers;
@@ -147,11 +202,22 @@ void draw()
       image, vk::Format::eR8G8B8A8Srgb, vk::ImageAspectFlagBits::eColor};
 
   auto commands{command_pool.create_command_buffers<max_in_flight>()};
+  std::array<Buffer, max_in_flight> chunk_infos;
+  std::array<std::array<Buffer, 3>, max_in_flight> cull_buffers;
+  for (gsl::index i{0}; i < max_in_flight; ++i) {
+    cull_buffers[i] = world.get_cull_buffers(i);
+    chunk_infos[i] = cull_buffers[i][0];
+  }
   auto descriptor_sets{descriptor_pool.create_descriptor_sets<max_in_flight>(
       uniform_buffers,
+      chunk_infos,
       sampler.get(),
       image_view.get(),
-      descriptor_set_layout.get())};
+      descriptor_set_layout.get(),
+      world.get_face_buffer())};
+  auto cull_sets{
+      descriptor_pool.create_storage_descriptor_sets<max_in_flight, 3>(
+          cull_buffers, cull_set_layout.get())};
 
   std::array<Fence, max_in_flight> render_done_fences;
   std::array<Semaphore, max_in_flight> render_done_semaphores;
@@ -186,11 +252,14 @@ void draw()
     }
 
     auto const curr_time{std::chrono::high_resolution_clock::now()};
+    auto const [visible, total]{world.get_cull_stats()};
+    auto const [compactions, reclaimed]{world.get_compaction_stats()};
     std::cout << 1e6
                      / std::chrono::duration_cast<std::chrono::microseconds>(
                            curr_time - prev_time)
                            .count()
-              << '\n';
+              << " fps, " << visible << '/' << total << " chunks visible, "
+              << reclaimed << " holes reclaimed\n";
     auto dt{std::chrono::duration<float>{curr_time - prev_time}.count()};
     prev_time = curr_time;
     if (!jumping && camera.move_speed != god_speed
@@ -233,21 +302,36 @@ void draw()
     if (get_key(swapchain.get_window(), Key::f))
       move = false;
 
-    if (transfer_fence.wait(0) && move) {
+    // a move reuses chunk buffers, so no copy into them may be in flight
+    if (move && upload_timeline.get_value() == upload_count)
+      world.move({std::round(camera.get_position().x / chunk_width),
+                  std::round(camera.get_position().z / chunk_depth)});
+
+    staging.reclaim();
+    if (upload_timeline.get_value() >= upload_values[current_upload]) {
+      // upload whatever the chunk streamer has finished so far
+      auto const transfer_cmd{transfer_cmds[current_upload]};
       transfer_cmd.reset();
       transfer_cmd.begin(vk::CommandBufferBeginInfo{});
-      world.move(transfer_cmd,
-                 staging_buffer,
-                 {std::round(camera.get_position().x / chunk_width),
-                  std::round(camera.get_position().z / chunk_depth)});
+      auto const uploaded{world.upload(transfer_cmd, staging)};
       transfer_cmd.end();
 
-      transfer_fence.reset();
-      g_context.get_queue<QueueType::graphics>().submit(
-          {{.waitSemaphoreCount{0},
-            .commandBufferCount{1},
-            .pCommandBuffers{&transfer_cmd}}},
-          transfer_fence.get());
+      if (uploaded) {
+        upload_values[current_upload] = ++upload_count;
+        vk::TimelineSemaphoreSubmitInfo const timeline_info{
+            .signalSemaphoreValueCount{1},
+            .pSignalSemaphoreValues{&upload_values[current_upload]}};
+        auto const timeline{upload_timeline.get()};
+        g_context.get_queue<QueueType::transfer>().submit(
+            {{.pNext{&timeline_info},
+              .waitSemaphoreCount{0},
+              .commandBufferCount{1},
+              .pCommandBuffers{&transfer_cmd},
+              .signalSemaphoreCount{1},
+              .pSignalSemaphores{&timeline}}});
+        staging.submit(timeline, upload_count);
+        current_upload = (current_upload + 1) % max_uploads_in_flight;
+      }
     }
 
     Uniform const ubo{
@@ -273,6 +357,9 @@ void draw()
           break;
     }
 
+    // rebuild the sections edited this frame
+    world.remesh();
+
     commands[current_frame].reset();
     commands[current_frame].begin(vk::CommandBufferBeginInfo{});
     constexpr std::array clear_values{
@@ -282,6 +369,26 @@ void draw()
         },
         vk::ClearValue{.depthStencil{1.f, 0u}}};
 
+    // the chunk block is only defragmented once no upload copies into it
+    world.update_meshes(commands[current_frame],
+                        staging,
+                        upload_timeline.get_value() == upload_count);
+
+    commands[current_frame].bindPipeline(vk::PipelineBindPoint::eCompute,
+                                         cull_pipeline.get_pipeline());
+    commands[current_frame].bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                               cull_pipeline.get_layout(),
+                                               0,
+                                               1,
+                                               &cull_sets[current_frame],
+                                               0,
+                                               nullptr);
+    world.cull(commands[current_frame],
+               current_frame,
+               cull_pipeline.get_layout(),
+               ubo.view_proj,
+               camera.get_position());
+
     commands[current_frame].beginRenderPass(
         {.renderPass{render_pass.get()},
          .framebuffer{framebuffers[image_index].get()},
@@ -290,8 +397,6 @@ void draw()
          .pClearValues{clear_values.data()}},
         vk::SubpassContents::eInline);
 
-    commands[current_frame].bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                         pipeline.get_pipeline());
     commands[current_frame].setViewport(
         0,
         {{.x{0.f},
@@ -302,39 +407,67 @@ void draw()
           .maxDepth{1.f}}});
     commands[current_frame].setScissor(0, {{{0, 0}, swapchain.get_extent()}});
 
+    // the layouts of the pipelines match, so the set stays bound across them
     commands[current_frame].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                               pipeline.get_layout(),
+                                               pipelines[0].get_layout(),
                                                0,
                                                1,
                                                &descriptor_sets[current_frame],
                                                0,
                                                nullptr);
-    world.draw(commands[current_frame],
-               pipeline.get_layout(),
-               glm::vec2{camera.get_position().x, camera.get_position().z},
-               glm::vec2{camera.get_front().x, camera.get_front().z});
+    // the opaque faces fill the depth buffer first, so the cutout and water
+    // fragments behind them are rejected before shading, and the water is
+    // blended over everything else
+    for (auto p{0}; p < nb_mesh_passes; ++p) {
+      commands[current_frame].bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                           pipelines[p].get_pipeline());
+      world.draw(commands[current_frame],
+                 current_frame,
+                 static_cast<MeshPass>(p));
+    }
 
     commands[current_frame].endRenderPass();
     commands[current_frame].end();
 
     render_done_fences[current_frame].reset();
 
-    std::array wait_semaphores{image_acquired_semaphores[current_frame].get()};
-    std::array<vk::PipelineStageFlags, 1> wait_stages{
-        vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    std::array signal_semaphores{render_done_semaphores[current_frame].get()};
+    // the culling pass runs while the last upload finishes, only the draws
+    // wait for it
+    std::array wait_semaphores{image_acquired_semaphores[current_frame].get(),
+                               upload_timeline.get()};
+    std::array<vk::PipelineStageFlags, 2> wait_stages{
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eVertexInput
+            | vk::PipelineStageFlagBits::eVertexShader};
+    std::array<uint64_t, 2> wait_values{0, upload_count};
+    std::array signal_semaphores{render_done_semaphores[current_frame].get(),
+                                 frame_timeline.get()};
+    std::array<uint64_t, 2> signal_values{0, ++frame_count};
+    vk::TimelineSemaphoreSubmitInfo const timeline_info{
+        .waitSemaphoreValueCount{
+            gsl::narrow<unsigned>(std::size(wait_values))},
+        .pWaitSemaphoreValues{wait_values.data()},
+        .signalSemaphoreValueCount{
+            gsl::narrow<unsigned>(std::size(signal_values))},
+        .pSignalSemaphoreValues{signal_values.data()}};
 
     g_context.get_queue<QueueType::graphics>().submit(
-        {{.waitSemaphoreCount{1},
+        {{.pNext{&timeline_info},
+          .waitSemaphoreCount{
+              gsl::narrow<unsigned>(std::size(wait_semaphores))},
           .pWaitSemaphores{wait_semaphores.data()},
           .pWaitDstStageMask{wait_stages.data()},
           .commandBufferCount{1},
           .pCommandBuffers{&commands[current_frame]},
-          .signalSemaphoreCount{1},
+          .signalSemaphoreCount{
+              gsl::narrow<unsigned>(std::size(signal_semaphores))},
           .pSignalSemaphores{signal_semaphores.data()}}},
         render_done_fences[current_frame].get());
+    staging.submit(frame_timeline.get(), frame_count);
 
-    if (!swapchain.present(image_index, signal_semaphores)) {
+    // the present waits for the binary semaphore alone
+    if (!swapchain.present(image_index,
+                           std::span{signal_semaphores}.first(1))) {
       framebuffers.clear();
       for (auto i{0}; i < std::size(swapchain); ++i) {
         std::array attachments{swapchain.get_image_view(i),
@@ -347,10 +480,21 @@ void draw()
 
     current_frame = (current_frame + 1) % max_in_flight;
 
-    if (glfwGetKey(swapchain.get_window(), GLFW_KEY_ESCAPE)) {
-      g_context.get_device().waitIdle();
-      return;
-    }
+    if (glfwGetKey(swapchain.get_window(), GLFW_KEY_ESCAPE))
+      break;
   }
   g_context.get_device().waitIdle();
+
+  std::cout << (greedy_meshing ? "greedy" : "per block") << " meshing: "
+            << world.count_faces() << " faces\n";
+  auto const [hits, misses]{height_map_cache().stats()};
+  std::cout << "height map cache: " << hits << " hits, " << misses
+            << " misses\n";
+  std::cout << "staging ring: " << (staging.get_peak_usage() >> 20) << " of "
+            << (staging.size() >> 20) << " MiB at peak\n";
+  for (auto&& [type, used, reserved, fragmentation] : world.get_memory_stats())
+    std::cout << "memory type " << type << ": " << (used >> 20) << " of "
+              << (reserved >> 20) << " MiB used, "
+              << gsl::narrow_cast<int>(fragmentation * 100)
+              << "% of the free space fragmented\n";
 }
@@ -4,6 +4,7 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include <array>
 #include <gsl/gsl>
 
 struct Buffer {
@@ -17,8 +18,21 @@ struct Uniform {
   alignas(16) glm::mat4 view_proj;
 };
 
-struct PushConstant {
-  glm::vec3 offset;
+// one per chunk slot, laid out like the Chunk block of cull.comp and vert.vert
+struct alignas(16) ChunkInfo {
+  glm::vec4 origin;
+  glm::vec4 aabb_min;
+  glm::vec4 aabb_max;
+  unsigned first_vertex;
+  // the opaque, cutout and water vertices, one pass after another
+  std::array<unsigned, 3> vertex_counts;
+  // where the water draw of the chunk goes, the farthest chunk first
+  unsigned water_rank;
+};
+
+struct CullConstant {
+  std::array<glm::vec4, 6> planes;
+  unsigned chunk_count;
 };
 
 struct Vertex {
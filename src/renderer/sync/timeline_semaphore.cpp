@@ -0,0 +1,39 @@
+#include "timeline_semaphore.h"
+
+namespace {
+  vk::Semaphore create_timeline_semaphore()
+  {
+    vk::SemaphoreTypeCreateInfo const type{
+        .semaphoreType{vk::SemaphoreType::eTimeline},
+        .initialValue{0}};
+    return g_context.get_device().createSemaphore({.pNext{&type}});
+  }
+} // namespace
+
+TimelineSemaphore::TimelineSemaphore() : handle_{create_timeline_semaphore()}
+{
+}
+
+TimelineSemaphore::TimelineSemaphore(TimelineSemaphore&& x) noexcept
+    : handle_{x.handle_}
+{
+  x.handle_ = nullptr;
+}
+
+TimelineSemaphore& TimelineSemaphore::operator=(TimelineSemaphore&& x) noexcept
+{
+  g_context.get_device().destroySemaphore(handle_);
+  handle_ = x.handle_;
+  x.handle_ = nullptr;
+  return *this;
+}
+
+TimelineSemaphore::~TimelineSemaphore()
+{
+  g_context.get_device().destroySemaphore(handle_);
+}
+
+uint64_t TimelineSemaphore::get_value() const
+{
+  return g_context.get_device().getSemaphoreCounterValue(handle_);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "core.h"
+
+#include <cstdint>
+
+// a semaphore with a counter that only goes up, a submission signals a value
+// that other queues wait for and the host polls
+class TimelineSemaphore {
+public:
+  TimelineSemaphore();
+  TimelineSemaphore(TimelineSemaphore const&) = delete;
+  TimelineSemaphore(TimelineSemaphore&&) noexcept;
+  TimelineSemaphore& operator=(TimelineSemaphore const&) = delete;
+  TimelineSemaphore& operator=(TimelineSemaphore&&) noexcept;
+  ~TimelineSemaphore();
+
+  vk::Semaphore get() const noexcept { return handle_; }
+
+  // the last value signaled
+  uint64_t get_value() const;
+private:
+  vk::Semaphore handle_;
+};
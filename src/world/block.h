@@ -25,10 +25,49 @@ enum class BlockType : unsigned char {
 
 enum class FaceType : unsigned char { up, down, left, right, front, back };
 
+// light passes through glass and water, so the faces next to them are drawn
+constexpr bool is_opaque(BlockType block) noexcept
+{
+  return block != BlockType::air && block != BlockType::glass
+      && block != BlockType::water;
+}
+
+// the pipeline a face is drawn with, a mesh holds the faces of each pass one
+// after another in this order
+enum class MeshPass : unsigned char { opaque, cutout, water };
+
+inline constexpr auto nb_mesh_passes{3};
+
+// the faces of a mesh in each pass
+using PassCounts = std::array<long long, nb_mesh_passes>;
+
+// only the blocks with holes in their tile pay for alpha testing, the
+// others keep early depth testing
+constexpr MeshPass get_mesh_pass(BlockType block) noexcept
+{
+  switch (block) {
+  case BlockType::glass:
+  case BlockType::leaves:
+    return MeshPass::cutout;
+  case BlockType::water:
+    return MeshPass::water;
+  default:
+    return MeshPass::opaque;
+  }
+}
+
+#if defined(CJCRAFT_VERTEX_PULLING)
+// one packed record per face, the vertex shader expands it to the corners
+struct Face {
+  static constexpr auto nb_vertices{6};
+  unsigned data{};
+};
+#else
 struct Face {
   static constexpr auto nb_vertices{6};
   std::array<Vertex, nb_vertices> data{};
 };
+#endif
 
 struct FaceKey {
   unsigned value;
@@ -48,24 +87,27 @@ struct FaceKeyHash {
   }
 };
 
-constexpr Vertex pack_vertex(glm::ivec3 pos, glm::ivec2 uv) noexcept
+// the texture coordinates are rebuilt from the position in the fragment
+// shader, so a face only carries its direction and the tile of the atlas
+constexpr Vertex
+pack_vertex(glm::ivec3 pos, FaceType face, glm::ivec2 tile) noexcept
 {
   return {(gsl::narrow_cast<unsigned>(pos.y) << 24)
-          | (gsl::narrow_cast<unsigned>(pos.x) << 16)
-          | (gsl::narrow_cast<unsigned>(pos.z) << 8)
-          | (gsl::narrow_cast<unsigned>(uv.y) << 4)
-          | (gsl::narrow_cast<unsigned>(uv.x))};
+          | (gsl::narrow_cast<unsigned>(pos.x) << 18)
+          | (gsl::narrow_cast<unsigned>(pos.z) << 12)
+          | (static_cast<unsigned>(face) << 8)
+          | (gsl::narrow_cast<unsigned>(tile.y) << 4)
+          | (gsl::narrow_cast<unsigned>(tile.x))};
 }
 
-constexpr Face
-get_vertices(BlockType block, FaceType face, glm::ivec3 pos) noexcept
+constexpr glm::ivec2 get_tile(BlockType block, FaceType face) noexcept
 {
-  glm::ivec2 uv_up;
-  glm::ivec2 uv_down;
-  glm::ivec2 uv_side;
+  glm::ivec2 uv_up{};
+  glm::ivec2 uv_down{};
+  glm::ivec2 uv_side{};
   switch (block) {
   case BlockType::air:
-    return {};
+    break;
   case BlockType::glass:
     uv_up = uv_down = uv_side = {1, 3};
     break;
@@ -109,59 +151,62 @@ get_vertices(BlockType block, FaceType face, glm::ivec3 pos) noexcept
     break;
   }
 
-  constexpr std::array<glm::ivec2, 4> uv_offsets{
-      {{0, 0}, {0, 1}, {1, 1}, {1, 0}}};
   switch (face) {
   case FaceType::up:
-    return {pack_vertex(pos + glm::ivec3{0, 0, 1}, uv_up + uv_offsets[0]),
-            pack_vertex(pos + glm::ivec3{0, 0, 0}, uv_up + uv_offsets[1]),
-            pack_vertex(pos + glm::ivec3{1, 0, 0}, uv_up + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 0, 0}, uv_up + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 0, 1}, uv_up + uv_offsets[3]),
-            pack_vertex(pos + glm::ivec3{0, 0, 1}, uv_up + uv_offsets[0])};
+    return uv_up;
+  case FaceType::down:
+    return uv_down;
+  default:
+    return uv_side;
+  }
+}
+
+#if defined(CJCRAFT_VERTEX_PULLING)
+// an empty record has the present bit cleared and draws nothing
+constexpr Face get_quad(FaceType face, glm::ivec2 tile, glm::ivec3 pos) noexcept
+{
+  return {pack_vertex(pos, face, tile).data | 1u << 11};
+}
+#else
+// size is the extent of the face along its two axes, (x, z) for up and down,
+// (x, y) for front and back, (z, y) for left and right
+constexpr Face get_quad(FaceType face,
+                        glm::ivec2 tile,
+                        glm::ivec3 pos,
+                        glm::ivec2 size = {1, 1}) noexcept
+{
+  auto const w{size.x};
+  auto const h{size.y};
+  auto const quad{[&](glm::ivec3 a, glm::ivec3 b, glm::ivec3 c, glm::ivec3 d) {
+    return Face{pack_vertex(pos + a, face, tile),
+                pack_vertex(pos + b, face, tile),
+                pack_vertex(pos + c, face, tile),
+                pack_vertex(pos + c, face, tile),
+                pack_vertex(pos + d, face, tile),
+                pack_vertex(pos + a, face, tile)};
+  }};
+  switch (face) {
+  case FaceType::up:
+    return quad({0, 0, h}, {0, 0, 0}, {w, 0, 0}, {w, 0, h});
   case FaceType::down:
-    return {pack_vertex(pos + glm::ivec3{0, 1, 0}, uv_down + uv_offsets[0]),
-            pack_vertex(pos + glm::ivec3{0, 1, 1}, uv_down + uv_offsets[1]),
-            pack_vertex(pos + glm::ivec3{1, 1, 1}, uv_down + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 1, 1}, uv_down + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 1, 0}, uv_down + uv_offsets[3]),
-            pack_vertex(pos + glm::ivec3{0, 1, 0}, uv_down + uv_offsets[0])};
+    return quad({0, 1, 0}, {0, 1, h}, {w, 1, h}, {w, 1, 0});
   case FaceType::front:
-    return {pack_vertex(pos + glm::ivec3{0, 0, 0}, uv_side + uv_offsets[0]),
-            pack_vertex(pos + glm::ivec3{0, 1, 0}, uv_side + uv_offsets[1]),
-            pack_vertex(pos + glm::ivec3{1, 1, 0}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 1, 0}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 0, 0}, uv_side + uv_offsets[3]),
-            pack_vertex(pos + glm::ivec3{0, 0, 0}, uv_side + uv_offsets[0])};
+    return quad({0, 0, 0}, {0, h, 0}, {w, h, 0}, {w, 0, 0});
   case FaceType::back:
-    return {pack_vertex(pos + glm::ivec3{1, 0, 1}, uv_side + uv_offsets[0]),
-            pack_vertex(pos + glm::ivec3{1, 1, 1}, uv_side + uv_offsets[1]),
-            pack_vertex(pos + glm::ivec3{0, 1, 1}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{0, 1, 1}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{0, 0, 1}, uv_side + uv_offsets[3]),
-            pack_vertex(pos + glm::ivec3{1, 0, 1}, uv_side + uv_offsets[0])};
+    return quad({w, 0, 1}, {w, h, 1}, {0, h, 1}, {0, 0, 1});
   case FaceType::left:
-    return {pack_vertex(pos + glm::ivec3{0, 0, 1}, uv_side + uv_offsets[0]),
-            pack_vertex(pos + glm::ivec3{0, 1, 1}, uv_side + uv_offsets[1]),
-            pack_vertex(pos + glm::ivec3{0, 1, 0}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{0, 1, 0}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{0, 0, 0}, uv_side + uv_offsets[3]),
-            pack_vertex(pos + glm::ivec3{0, 0, 1}, uv_side + uv_offsets[0])};
+    return quad({0, 0, w}, {0, h, w}, {0, h, 0}, {0, 0, 0});
   case FaceType::right:
-    return {pack_vertex(pos + glm::ivec3{1, 0, 0}, uv_side + uv_offsets[0]),
-            pack_vertex(pos + glm::ivec3{1, 1, 0}, uv_side + uv_offsets[1]),
-            pack_vertex(pos + glm::ivec3{1, 1, 1}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 1, 1}, uv_side + uv_offsets[2]),
-            pack_vertex(pos + glm::ivec3{1, 0, 1}, uv_side + uv_offsets[3]),
-            pack_vertex(pos + glm::ivec3{1, 0, 0}, uv_side + uv_offsets[0])};
+    return quad({1, 0, 0}, {1, h, 0}, {1, h, w}, {1, 0, w});
   }
   return {};
 }
+#endif
 
-constexpr unsigned pack_face_key(FaceType t, glm::ivec3 pos) noexcept
+constexpr Face
+get_vertices(BlockType block, FaceType face, glm::ivec3 pos) noexcept
 {
-  return {(static_cast<unsigned>(t) << 24)
-          | (gsl::narrow_cast<unsigned>(pos.x) << 16)
-          | (gsl::narrow_cast<unsigned>(pos.y) << 8)
-          | (gsl::narrow_cast<unsigned>(pos.z))};
+  if (block == BlockType::air)
+    return {};
+  return get_quad(face, get_tile(block, face), pos);
 }
@@ -1,125 +1,306 @@
 #include "chunk.h"
+#include "height_map_cache.h"
 
 #include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <ranges>
+#include <span>
 
 namespace {
+#if !defined(CJCRAFT_VERTEX_PULLING)
+  struct GreedyFace {
+    MeshPass pass;
+    FaceType face;
+    glm::ivec2 tile;
+    glm::ivec3 pos;
+  };
+#endif
+
+  // the faces of a mesh written straight to their place, without growing,
+  // given the faces of each pass every pass starts where the ones before it
+  // end, else the faces have to come pass by pass, those past the end are
+  // counted but not written
+  class FaceSink {
+  public:
+    explicit FaceSink(std::span<Face> faces) noexcept
+        : faces_{faces}, ordered_{true}
+    {
+    }
+
+    FaceSink(std::span<Face> faces, PassCounts const& counts) noexcept
+        : faces_{faces}, ordered_{false}
+    {
+      std::exclusive_scan(
+          std::begin(counts), std::end(counts), std::begin(first_), 0ll);
+    }
+
+    void push_back(MeshPass pass, Face const& face) noexcept
+    {
+      auto const p{static_cast<int>(pass)};
+      if (auto const i{ordered_ ? size_ : first_[p] + counts_[p]};
+          i < std::ssize(faces_))
+        faces_[i] = face;
+      ++counts_[p];
+      ++size_;
+    }
+
+    PassCounts finish() const noexcept { return counts_; }
+  private:
+    std::span<Face> faces_;
+    bool ordered_;
+    PassCounts first_{};
+    long long size_{};
+    PassCounts counts_{};
+  };
+
   constexpr std::pair<std::array<BlockType, 3>, int>
   get_types_and_height(float height) noexcept;
 
-  void fill_side_faces(std::vector<Face>& faces,
+  // call emit(block, face, pos) for every face of a cold chunk
+  template<typename F>
+  void for_each_cold_face(HeightMap const& height_map, F&& emit);
+
+  // the side faces of a column run down to the top of the lower column next
+  // to it, or to the bedrock if the water of that one hides nothing
+  constexpr int get_side_end(std::array<BlockType, 3> types,
+                             std::array<BlockType, 3> lower_types,
+                             int lower_height) noexcept;
+
+  template<typename F>
+  void fill_side_faces(F&& emit,
                        std::array<BlockType, 3> types,
                        FaceType face,
                        int height_begin,
                        int height_end,
                        glm::ivec2 pos);
 
-  void fill_hot_side_faces(std::vector<Face>& faces,
-                           HashMap<unsigned, unsigned>& map,
-                           std::array<BlockType, 3> types,
-                           FaceType face,
-                           int height_begin,
-                           int height_end,
-                           glm::ivec2 pos);
+#if !defined(CJCRAFT_VERTEX_PULLING)
+  PassCounts merge_faces(std::span<GreedyFace const> faces,
+                         std::span<Face> merged);
+#endif
+
+  // bit x of a row is set if the block at x has the property
+  using Rows = std::array<uint64_t, chunk_depth + 1>;
+
+  // the layers from first on
+  struct Occupancy {
+    int first;
+    std::vector<Rows> solid;
+    std::vector<Rows> opaque;
+    std::vector<Rows> water;
+  };
+
+  Occupancy get_occupancy(Terrain const& terrain, int first, int last);
+
+  // call emit(block, face, pos) for every visible face a chunk owns in the
+  // layers y_begin to y_end, found a row of 64 blocks at a time
+  template<typename F>
+  void for_each_terrain_face(Terrain const& terrain,
+                             int y_begin,
+                             int y_end,
+                             F&& emit);
 } // namespace
 
-std::vector<Face> create_chunk(glm::ivec2 offset)
+PassCounts count_chunk_faces(glm::ivec2 offset)
 {
-  auto const height_map{
-      generate_height_map({chunk_width * offset.x, chunk_depth * offset.y})};
-  std::vector<Face> faces;
-  for (auto i{0}; i < chunk_width; ++i)
-    for (auto j{0}; j < chunk_depth; ++j) {
-      auto const [types, height]{get_types_and_height(height_map[i][j])};
-      faces.push_back(get_vertices(types[0], FaceType::up, glm::ivec3{i, height, j}));
-
-      if (auto const [back_types,
-                      back_height]{get_types_and_height(height_map[i][j + 1])};
-          height < back_height)
-        fill_side_faces(
-            faces, types, FaceType::back, height, back_height, {i, j});
-      else
-        fill_side_faces(faces,
-                        back_types,
-                        FaceType::front,
-                        back_height,
-                        height,
-                        {i, j + 1});
-
-      if (auto const [right_types,
-                      right_height]{get_types_and_height(height_map[i + 1][j])};
-          height < right_height)
-        fill_side_faces(
-            faces, types, FaceType::right, height, right_height, {i, j});
-      else
-        fill_side_faces(faces,
-                        right_types,
-                        FaceType::left,
-                        right_height,
-                        height,
-                        {i + 1, j});
-    }
-  return faces;
+  auto const cached{height_map_cache().get(offset)};
+  PassCounts counts{};
+  for_each_cold_face(*cached, [&](BlockType block, FaceType, glm::ivec3) {
+    ++counts[static_cast<int>(get_mesh_pass(block))];
+  });
+  return counts;
 }
 
-std::tuple<std::vector<Face>, HashMap<unsigned, unsigned>, Terrain>
-create_hot_chunk(glm::ivec2 offset)
+PassCounts create_chunk(glm::ivec2 offset, std::span<Face> faces)
 {
-  auto const height_map{
-      generate_height_map({chunk_width * offset.x, chunk_depth * offset.y})};
-  std::vector<Face> faces;
-  HashMap<unsigned, unsigned> map;
-  Terrain terrain(chunk_width + 1);
+  auto const cached{height_map_cache().get(offset)};
+  FaceSink sink{faces, count_chunk_faces(offset)};
+  for_each_cold_face(*cached,
+                     [&](BlockType block, FaceType face, glm::ivec3 pos) {
+                       sink.push_back(get_mesh_pass(block),
+                                      get_vertices(block, face, pos));
+                     });
+  return sink.finish();
+}
+
+#if !defined(CJCRAFT_VERTEX_PULLING)
+PassCounts create_greedy_chunk(glm::ivec2 offset, std::span<Face> merged)
+{
+  auto const cached{height_map_cache().get(offset)};
+  std::vector<GreedyFace> faces;
+  for_each_cold_face(*cached,
+                     [&](BlockType block, FaceType face, glm::ivec3 pos) {
+                       faces.push_back({get_mesh_pass(block),
+                                        face,
+                                        get_tile(block, face),
+                                        pos});
+                     });
+  return merge_faces(faces, merged);
+}
+#endif
+
+Terrain create_terrain(glm::ivec2 offset)
+{
+  auto const cached{height_map_cache().get(offset)};
+  auto const& height_map{*cached};
+
+  // below the deepest surface every column is stone down to the bedrock, so
+  // those sections are filled whole and the columns only fill the rest
+  auto stone_top{0};
+  for (auto i{0}; i < chunk_width + 1; ++i)
+    for (auto j{0}; j < chunk_depth + 1; ++j)
+      stone_top = std::max(stone_top,
+                           get_types_and_height(height_map[i][j]).second
+                               + first_layer_height + second_layer_height);
+  Terrain terrain;
+  terrain.fill_layer(chunk_height - bedrock_layer_height,
+                     chunk_height,
+                     BlockType::bedrock);
+  terrain.fill_layer(
+      stone_top, chunk_height - bedrock_layer_height, BlockType::stone);
+
   for (auto i{0}; i < chunk_width + 1; ++i)
     for (auto j{0}; j < chunk_depth + 1; ++j) {
       auto const [types, height]{get_types_and_height(height_map[i][j])};
-      std::fill_n(
-          std::begin(terrain[i][j]) + height, first_layer_height, types[0]);
-      std::fill_n(std::begin(terrain[i][j]) + height + first_layer_height,
-                  second_layer_height,
-                  types[1]);
-      std::fill(std::begin(terrain[i][j]) + height + first_layer_height
-                    + second_layer_height,
-                std::end(terrain[i][j]) - bedrock_layer_height,
-                types[2]);
-      std::fill(std::end(terrain[i][j]) - bedrock_layer_height,
-                std::end(terrain[i][j]),
-                BlockType::bedrock);
-      if (i == chunk_width || j == chunk_depth)
-        continue;
-
-      map[pack_face_key(FaceType::up, {i, height, j})] = std::size(faces);
-      faces.push_back(
-          get_vertices(types[0], FaceType::up, glm::ivec3{i, height, j}));
-
-      if (auto const [back_types,
-                      back_height]{get_types_and_height(height_map[i][j + 1])};
-          height < back_height)
-        fill_hot_side_faces(
-            faces, map, types, FaceType::back, height, back_height, {i, j});
-      else
-        fill_hot_side_faces(faces,
-                            map,
-                            back_types,
-                            FaceType::front,
-                            back_height,
-                            height,
-                            {i, j + 1});
-
-      if (auto const [right_types,
-                      right_height]{get_types_and_height(height_map[i + 1][j])};
-          height < right_height)
-        fill_hot_side_faces(
-            faces, map, types, FaceType::right, height, right_height, {i, j});
-      else
-        fill_hot_side_faces(faces,
-                            map,
-                            right_types,
-                            FaceType::left,
-                            right_height,
-                            height,
-                            {i + 1, j});
+      terrain.fill_column(
+          {i, j}, height, height + first_layer_height, types[0]);
+      terrain.fill_column({i, j},
+                          height + first_layer_height,
+                          height + first_layer_height + second_layer_height,
+                          types[1]);
+      terrain.fill_column({i, j},
+                          height + first_layer_height + second_layer_height,
+                          types[2] == BlockType::stone
+                              ? stone_top
+                              : chunk_height - bedrock_layer_height,
+                          types[2]);
     }
-  return {faces, map, terrain};
+  return terrain;
+}
+
+BlockType get_generated_block(glm::ivec2 offset, glm::ivec3 pos)
+{
+  auto const cached{height_map_cache().get(offset)};
+  auto const [types, height]{get_types_and_height((*cached)[pos.x][pos.z])};
+  if (pos.y < height)
+    return BlockType::air;
+  if (pos.y < height + first_layer_height)
+    return types[0];
+  if (pos.y < height + first_layer_height + second_layer_height)
+    return types[1];
+  if (pos.y < chunk_height - bedrock_layer_height)
+    return types[2];
+  return BlockType::bedrock;
+}
+
+PassCounts create_terrain_mesh(Terrain const& terrain,
+                               bool greedy,
+                               std::span<Face> faces)
+{
+#if !defined(CJCRAFT_VERTEX_PULLING)
+  if (greedy) {
+    std::vector<GreedyFace> greedy_faces;
+    for_each_terrain_face(
+        terrain,
+        0,
+        chunk_height,
+        [&](BlockType block, FaceType face, glm::ivec3 pos) {
+          greedy_faces.push_back(
+              {get_mesh_pass(block), face, get_tile(block, face), pos});
+        });
+    return merge_faces(greedy_faces, faces);
+  }
+#endif
+  // the faces are counted first so each pass is written in its place
+  PassCounts counts{};
+  for_each_terrain_face(
+      terrain, 0, chunk_height, [&](BlockType block, FaceType, glm::ivec3) {
+        ++counts[static_cast<int>(get_mesh_pass(block))];
+      });
+  FaceSink sink{faces, counts};
+  for_each_terrain_face(
+      terrain,
+      0,
+      chunk_height,
+      [&](BlockType block, FaceType face, glm::ivec3 pos) {
+        sink.push_back(get_mesh_pass(block), get_vertices(block, face, pos));
+      });
+  return sink.finish();
+}
+
+void append_section_mesh(
+    Terrain const& terrain,
+    int section,
+    std::span<std::vector<Face>, nb_mesh_passes> faces)
+{
+  for_each_terrain_face(
+      terrain,
+      section * section_height,
+      std::min(chunk_height, (section + 1) * section_height),
+      [&](BlockType block, FaceType face, glm::ivec3 pos) {
+        faces[static_cast<int>(get_mesh_pass(block))].push_back(
+            get_vertices(block, face, pos));
+      });
+}
+
+Terrain::Terrain()
+{
+  sections_.fill(PaletteStorage{section_size});
+}
+
+void Terrain::fill_column(glm::ivec2 column,
+                          int y_begin,
+                          int y_end,
+                          BlockType block)
+{
+  for (auto y{y_begin}; y < y_end;) {
+    auto const end{std::min(y_end, (y / section_height + 1) * section_height)};
+    auto const first{get_index({column.x, y, column.y})};
+    sections_[y / section_height].fill(first, first + end - y, block);
+    y = end;
+  }
+}
+
+void Terrain::fill_layer(int y_begin, int y_end, BlockType block)
+{
+  for (auto s{y_begin / section_height}; s * section_height < y_end; ++s) {
+    auto const begin{std::max(y_begin, s * section_height)};
+    auto const end{std::min(y_end, (s + 1) * section_height)};
+    if (begin == s * section_height
+        && end == std::min(chunk_height, (s + 1) * section_height))
+      sections_[s].fill(0, section_size, block);
+    else
+      for (auto i{0}; i < chunk_width + 1; ++i)
+        for (auto j{0}; j < chunk_depth + 1; ++j)
+          fill_column({i, j}, begin, end, block);
+  }
+}
+
+long long Terrain::get_memory_usage() const noexcept
+{
+  return std::transform_reduce(std::begin(sections_),
+                               std::end(sections_),
+                               0ll,
+                               std::plus{},
+                               [](PaletteStorage const& s) {
+                                 return s.get_memory_usage();
+                               });
+}
+
+std::pair<int, int> get_height_range(glm::ivec2 offset)
+{
+  // the surface height grows with the noise, and the side faces of a column
+  // never reach past the surface of its neighbors
+  auto const cached{height_map_cache().get(offset)};
+  auto const [low, high]{std::ranges::minmax(*cached | std::views::join)};
+  // a lake shows the bedrock under it
+  auto const [types, bottom]{get_types_and_height(high)};
+  return {get_types_and_height(low).second,
+          types[0] == BlockType::water ? chunk_height - bedrock_layer_height + 1
+                                       : bottom + 1};
 }
 
 namespace {
@@ -138,7 +319,66 @@ namespace {
       return {{BlockType::snow, BlockType::dirt, BlockType::stone}, th};
   }
 
-  void fill_side_faces(std::vector<Face>& faces,
+  template<typename F>
+  void for_each_cold_face(HeightMap const& height_map, F&& emit)
+  {
+    for (auto i{0}; i < chunk_width; ++i)
+      for (auto j{0}; j < chunk_depth; ++j) {
+        auto const [types, height]{get_types_and_height(height_map[i][j])};
+        emit(types[0], FaceType::up, glm::ivec3{i, height, j});
+        // the bed of a lake shows through its water
+        if (types[0] == BlockType::water)
+          emit(BlockType::bedrock,
+               FaceType::up,
+               glm::ivec3{i, chunk_height - bedrock_layer_height, j});
+
+        if (auto const [back_types, back_height]{
+                get_types_and_height(height_map[i][j + 1])};
+            height < back_height)
+          fill_side_faces(emit,
+                          types,
+                          FaceType::back,
+                          height,
+                          get_side_end(types, back_types, back_height),
+                          {i, j});
+        else
+          fill_side_faces(emit,
+                          back_types,
+                          FaceType::front,
+                          back_height,
+                          get_side_end(back_types, types, height),
+                          {i, j + 1});
+
+        if (auto const [right_types, right_height]{
+                get_types_and_height(height_map[i + 1][j])};
+            height < right_height)
+          fill_side_faces(emit,
+                          types,
+                          FaceType::right,
+                          height,
+                          get_side_end(types, right_types, right_height),
+                          {i, j});
+        else
+          fill_side_faces(emit,
+                          right_types,
+                          FaceType::left,
+                          right_height,
+                          get_side_end(right_types, types, height),
+                          {i + 1, j});
+      }
+  }
+
+  constexpr int get_side_end(std::array<BlockType, 3> types,
+                             std::array<BlockType, 3> lower_types,
+                             int lower_height) noexcept
+  {
+    return types[0] != BlockType::water && lower_types[0] == BlockType::water
+             ? chunk_height - bedrock_layer_height
+             : lower_height;
+  }
+
+  template<typename F>
+  void fill_side_faces(F&& emit,
                        std::array<BlockType, 3> types,
                        FaceType face,
                        int height_begin,
@@ -147,47 +387,221 @@ namespace {
   {
     for (auto k{0}; height_begin < height_end && k < first_layer_height;
          ++height_begin, ++k)
-      faces.push_back(
-          get_vertices(types[0], face, glm::ivec3{pos.x, height_begin, pos.y}));
+      emit(types[0], face, glm::ivec3{pos.x, height_begin, pos.y});
     for (auto k{0}; height_begin < height_end && k < second_layer_height;
          ++height_begin, ++k)
-      faces.push_back(
-          get_vertices(types[1], face, glm::ivec3{pos.x, height_begin, pos.y}));
+      emit(types[1], face, glm::ivec3{pos.x, height_begin, pos.y});
     while (height_begin < height_end) {
-      faces.push_back(
-          get_vertices(types[2], face, glm::ivec3{pos.x, height_begin, pos.y}));
+      emit(types[2], face, glm::ivec3{pos.x, height_begin, pos.y});
       ++height_begin;
     }
   }
 
-  void fill_hot_side_faces(std::vector<Face>& faces,
-                           HashMap<unsigned, unsigned>& map,
-                           std::array<BlockType, 3> types,
-                           FaceType face,
-                           int height_begin,
-                           int height_end,
-                           glm::ivec2 pos)
+  Occupancy get_occupancy(Terrain const& terrain, int first, int last)
   {
-    for (auto k{0}; height_begin < height_end && k < first_layer_height;
-         ++height_begin, ++k) {
-      map[pack_face_key(face, glm::ivec3{pos.x, height_begin, pos.y})] =
-          std::size(faces);
-      faces.push_back(
-          get_vertices(types[0], face, glm::ivec3{pos.x, height_begin, pos.y}));
+    Occupancy occupancy{first,
+                        std::vector<Rows>(last - first),
+                        std::vector<Rows>(last - first),
+                        std::vector<Rows>(last - first)};
+    for (auto y{first}; y < last; ++y) {
+      auto& solid{occupancy.solid[y - first]};
+      auto& opaque{occupancy.opaque[y - first]};
+      auto& water{occupancy.water[y - first]};
+      if (terrain.is_uniform(y / section_height)) {
+        auto const block{terrain.get({0, y, 0})};
+        solid.fill(block != BlockType::air ? ~uint64_t{0} : 0);
+        opaque.fill(is_opaque(block) ? ~uint64_t{0} : 0);
+        water.fill(block == BlockType::water ? ~uint64_t{0} : 0);
+        continue;
+      }
+      for (auto z{0}; z < chunk_depth + 1; ++z)
+        for (auto x{0}; x < chunk_width + 1; ++x) {
+          auto const block{terrain.get({x, y, z})};
+          solid[z] |= uint64_t{block != BlockType::air} << x;
+          opaque[z] |= uint64_t{is_opaque(block)} << x;
+          water[z] |= uint64_t{block == BlockType::water} << x;
+        }
     }
-    for (auto k{0}; height_begin < height_end && k < second_layer_height;
-         ++height_begin, ++k) {
-      map[pack_face_key(face, glm::ivec3{pos.x, height_begin, pos.y})] =
-          std::size(faces);
-      faces.push_back(
-          get_vertices(types[1], face, glm::ivec3{pos.x, height_begin, pos.y}));
+    return occupancy;
+  }
+
+  template<typename F>
+  void for_each_terrain_face(Terrain const& terrain,
+                             int y_begin,
+                             int y_end,
+                             F&& emit)
+  {
+    // the blocks of an empty section have no faces, so the air above the
+    // surface is skipped whole
+    while (y_begin < y_end && terrain.is_empty(y_begin / section_height))
+      y_begin = (y_begin / section_height + 1) * section_height;
+    while (y_end > y_begin && terrain.is_empty((y_end - 1) / section_height))
+      y_end = std::max(y_begin, (y_end - 1) / section_height * section_height);
+    if (y_begin >= y_end)
+      return;
+
+    // the layers next to the range decide the faces on its top and bottom
+    auto const [first, solid, opaque, water]{
+        get_occupancy(terrain,
+                      std::max(0, y_begin - 1),
+                      std::min(chunk_height, y_end + 1))};
+    // the columns the chunk owns, the last one belongs to the next chunk
+    constexpr auto inner{(uint64_t{1} << chunk_width) - 1};
+    auto const emit_row{[&](uint64_t row, FaceType face, int y, int z) {
+      while (row != 0) {
+        glm::ivec3 const pos{std::countr_zero(row), y, z};
+        row &= row - 1;
+        emit(terrain.get(pos), face, pos);
+      }
+    }};
+
+    for (auto y{y_begin}; y < y_end; ++y)
+      for (auto z{0}; z < chunk_depth + 1; ++z) {
+        auto const& layer{opaque[y - first]};
+        auto const& wet{water[y - first]};
+        auto const s{solid[y - first][z]};
+        auto const o{layer[z]};
+        auto const w{wet[z]};
+        if (s == 0)
+          continue;
+
+        // a face shows unless the block it faces is opaque and the block is
+        // opaque or water, or both are water, nothing is drawn below the
+        // world
+        auto const hidden{[&](uint64_t next_opaque, uint64_t next_water) {
+          return ((o | w) & next_opaque) | (w & next_water);
+        }};
+        if (z < chunk_depth) {
+          auto const above{y > 0 ? hidden(opaque[y - 1 - first][z],
+                                          water[y - 1 - first][z])
+                                 : 0};
+          auto const below{y + 1 < chunk_height
+                               ? hidden(opaque[y + 1 - first][z],
+                                        water[y + 1 - first][z])
+                               : o | w};
+          emit_row(s & ~above & inner, FaceType::up, y, z);
+          emit_row(s & ~below & inner, FaceType::down, y, z);
+          emit_row(s & ~hidden(o >> 1, w >> 1) & inner, FaceType::right, y, z);
+          emit_row(s & ~hidden(o << 1, w << 1) & ~uint64_t{1},
+                   FaceType::left,
+                   y,
+                   z);
+          emit_row(s & ~hidden(layer[z + 1], wet[z + 1]) & inner,
+                   FaceType::back,
+                   y,
+                   z);
+        }
+        if (z > 0)
+          emit_row(s & ~hidden(layer[z - 1], wet[z - 1]) & inner,
+                   FaceType::front,
+                   y,
+                   z);
+      }
+  }
+
+#if !defined(CJCRAFT_VERTEX_PULLING)
+  PassCounts merge_faces(std::span<GreedyFace const> faces,
+                         std::span<Face> merged)
+  {
+    // the plane a face lies in and its position on that plane
+    auto const project{[](GreedyFace const& f) {
+      switch (f.face) {
+      case FaceType::up:
+      case FaceType::down:
+        return glm::ivec3{f.pos.y, f.pos.x, f.pos.z};
+      case FaceType::front:
+      case FaceType::back:
+        return glm::ivec3{f.pos.z, f.pos.x, f.pos.y};
+      default:
+        return glm::ivec3{f.pos.x, f.pos.z, f.pos.y};
+      }
+    }};
+    auto const unproject{[](FaceType face, int plane, int u, int v) {
+      switch (face) {
+      case FaceType::up:
+      case FaceType::down:
+        return glm::ivec3{u, plane, v};
+      case FaceType::front:
+      case FaceType::back:
+        return glm::ivec3{u, v, plane};
+      default:
+        return glm::ivec3{plane, v, u};
+      }
+    }};
+
+    // the faces of a pass are never merged with those of another, and the
+    // passes come one after another
+    std::vector<std::pair<uint64_t, gsl::index>> order;
+    order.reserve(std::size(faces));
+    for (gsl::index i{0}; i < std::ssize(faces); ++i) {
+      auto const p{project(faces[i])};
+      order.push_back({static_cast<uint64_t>(faces[i].pass) << 32
+                           | static_cast<uint64_t>(faces[i].face) << 24
+                           | static_cast<uint64_t>(p.x) << 16,
+                       i});
     }
-    while (height_begin < height_end) {
-      map[pack_face_key(face, glm::ivec3{pos.x, height_begin, pos.y})] =
-          std::size(faces);
-      faces.push_back(
-          get_vertices(types[2], face, glm::ivec3{pos.x, height_begin, pos.y}));
-      ++height_begin;
+    std::ranges::sort(order);
+
+    FaceSink sink{merged};
+    std::vector<unsigned short> mask;
+    for (auto first{std::begin(order)}; first != std::end(order);) {
+      auto const last{std::find_if(first, std::end(order), [&](auto const& o) {
+        return o.first != first->first;
+      })};
+
+      // lay the faces of one plane out in a grid of tiles, 0 for no face
+      auto const pass{faces[first->second].pass};
+      auto const face{faces[first->second].face};
+      auto const plane{project(faces[first->second]).x};
+      glm::ivec2 low{std::numeric_limits<int>::max()};
+      glm::ivec2 high{std::numeric_limits<int>::min()};
+      for (auto it{first}; it != last; ++it) {
+        auto const p{project(faces[it->second])};
+        low = glm::min(low, glm::ivec2{p.y, p.z});
+        high = glm::max(high, glm::ivec2{p.y, p.z});
+      }
+      auto const width{high.x - low.x + 1};
+      auto const height{high.y - low.y + 1};
+      mask.assign(width * height, 0);
+      for (auto it{first}; it != last; ++it) {
+        auto const& f{faces[it->second]};
+        auto const p{project(f)};
+        mask[(p.z - low.y) * width + p.y - low.x] =
+            gsl::narrow_cast<unsigned short>((f.tile.y << 4 | f.tile.x) + 1);
+      }
+
+      // grow each face along u first, then along v while the whole row
+      // matches
+      for (auto v{0}; v < height; ++v)
+        for (auto u{0}; u < width;) {
+          auto const tile{mask[v * width + u]};
+          if (tile == 0) {
+            ++u;
+            continue;
+          }
+          auto w{1};
+          while (u + w < width && mask[v * width + u + w] == tile)
+            ++w;
+          auto h{1};
+          while (v + h < height
+                 && std::all_of(std::begin(mask) + (v + h) * width + u,
+                                std::begin(mask) + (v + h) * width + u + w,
+                                [&](unsigned short t) { return t == tile; }))
+            ++h;
+          for (auto k{0}; k < h; ++k)
+            std::fill_n(std::begin(mask) + (v + k) * width + u, w, 0);
+
+          sink.push_back(
+              pass,
+              get_quad(face,
+                       {(tile - 1) & 0xf, (tile - 1) >> 4},
+                       unproject(face, plane, low.x + u, low.y + v),
+                       {w, h}));
+          u += w;
+        }
+      first = last;
     }
+    return sink.finish();
   }
+#endif
 } // namespace
@@ -3,8 +3,10 @@
 #include "block.h"
 #include "container/hash_map.h"
 #include "glm/glm.hpp"
+#include "palette_storage.h"
 
 #include <array>
+#include <span>
 #include <tuple>
 #include <vector>
 
@@ -16,12 +18,92 @@ inline constexpr auto first_layer_height{1};
 inline constexpr auto second_layer_height{4};
 inline constexpr auto bedrock_layer_height{4};
 
-using Terrain = std::vector<
-    std::array<std::array<BlockType, chunk_height>, chunk_depth + 1>>;
+inline constexpr auto section_height{16};
+inline constexpr auto nb_sections{(chunk_height + section_height - 1)
+                                  / section_height};
+
+// the blocks of a hot chunk including the border it shares with its
+// neighbors, split into sections of section_height layers that only hold
+// indices when they mix block types
+class Terrain {
+public:
+  Terrain();
+
+  BlockType get(glm::ivec3 pos) const noexcept
+  {
+    return sections_[pos.y / section_height].get(get_index(pos));
+  }
+
+  void set(glm::ivec3 pos, BlockType block)
+  {
+    sections_[pos.y / section_height].set(get_index(pos), block);
+  }
+
+  // set the blocks of the column at x, z from y_begin up to y_end
+  void fill_column(glm::ivec2 column, int y_begin, int y_end, BlockType block);
+
+  // set the blocks of every column from y_begin up to y_end, the sections in
+  // between become uniform
+  void fill_layer(int y_begin, int y_end, BlockType block);
+
+  bool is_uniform(int section) const noexcept
+  {
+    return sections_[section].is_uniform();
+  }
+
+  // nothing in the section has to be meshed or collided with
+  bool is_empty(int section) const noexcept
+  {
+    return is_uniform(section) && sections_[section].get(0) == BlockType::air;
+  }
+
+  long long get_memory_usage() const noexcept;
+private:
+  static constexpr long long section_size{
+      static_cast<long long>(chunk_width + 1) * (chunk_depth + 1)
+      * section_height};
+
+  // a column of a section is a single run
+  static long long get_index(glm::ivec3 pos) noexcept
+  {
+    return (static_cast<long long>(pos.x) * (chunk_depth + 1) + pos.z)
+             * section_height
+         + pos.y % section_height;
+  }
+
+  std::array<PaletteStorage, nb_sections> sections_{};
+};
+
 using HeightMap = std::vector<std::array<float, chunk_depth + 1>>;
 
-std::vector<Face> create_chunk(glm::ivec2 offset);
-std::tuple<std::vector<Face>, HashMap<unsigned, unsigned>, Terrain>
-create_hot_chunk(glm::ivec2 offset);
+// the faces of each pass create_chunk makes for a chunk, without making them
+PassCounts count_chunk_faces(glm::ivec2 offset);
+
+// the mesh generators write straight to faces in the order of the passes and
+// return how many faces each pass has, faces has to hold them all
+PassCounts create_chunk(glm::ivec2 offset, std::span<Face> faces);
+#if !defined(CJCRAFT_VERTEX_PULLING)
+// merge coplanar faces of the same tile into larger quads
+PassCounts create_greedy_chunk(glm::ivec2 offset, std::span<Face> faces);
+#endif
+// the blocks of a chunk as generated, before any edit
+Terrain create_terrain(glm::ivec2 offset);
+
+// the block create_terrain puts at a position of a chunk
+BlockType get_generated_block(glm::ivec2 offset, glm::ivec3 pos);
+
+// every face a chunk owns, merged into larger quads if greedy
+PassCounts create_terrain_mesh(Terrain const& terrain,
+                               bool greedy,
+                               std::span<Face> faces);
+
+// append the faces a chunk owns in one section to those of their pass
+void append_section_mesh(
+    Terrain const& terrain,
+    int section,
+    std::span<std::vector<Face>, nb_mesh_passes> faces);
 
 HeightMap generate_height_map(glm::ivec2 offset);
+
+// the y range covered by the faces of a chunk that was never edited
+std::pair<int, int> get_height_range(glm::ivec2 offset);
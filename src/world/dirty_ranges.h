@@ -0,0 +1,46 @@
+#pragma once
+
+#include "container/vector.h"
+
+#include <algorithm>
+#include <utility>
+
+// sorted disjoint ranges of faces, a range added over or next to others is
+// merged with them so each one becomes a single copy region
+class DirtyRanges {
+public:
+  using Range = std::pair<unsigned, unsigned>;
+
+  void add(unsigned first, unsigned last)
+  {
+    if (first >= last)
+      return;
+    auto it{std::ranges::lower_bound(ranges_, first, {}, &Range::second)};
+    auto end{it};
+    for (; end != std::end(ranges_) && end->first <= last; ++end) {
+      first = std::min(first, end->first);
+      last = std::max(last, end->second);
+    }
+    it = ranges_.erase(it, end);
+    ranges_.insert(it, {first, last});
+  }
+
+  // drop what lies past end
+  void clip(unsigned end)
+  {
+    ranges_.erase(std::ranges::lower_bound(ranges_, end, {}, &Range::first),
+                  std::end(ranges_));
+    if (!std::empty(ranges_))
+      ranges_.back().second = std::min(ranges_.back().second, end);
+  }
+
+  void clear() noexcept { ranges_.clear(); }
+
+  bool empty() const noexcept { return std::empty(ranges_); }
+
+  auto begin() const noexcept { return std::begin(ranges_); }
+
+  auto end() const noexcept { return std::end(ranges_); }
+private:
+  Vector<Range> ranges_{};
+};
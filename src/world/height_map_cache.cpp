@@ -0,0 +1,64 @@
+#include "height_map_cache.h"
+
+namespace {
+  constexpr uint64_t pack_offset(glm::ivec2 offset) noexcept
+  {
+    return static_cast<uint64_t>(static_cast<uint32_t>(offset.x)) << 32
+         | static_cast<uint32_t>(offset.y);
+  }
+} // namespace
+
+HeightMapCache::HeightMapCache(long long capacity) : capacity_{capacity} {}
+
+std::shared_ptr<HeightMap const> HeightMapCache::get(glm::ivec2 offset)
+{
+  auto const key{pack_offset(offset)};
+  {
+    std::scoped_lock lock{mutex_};
+    if (auto const it{index_.find(key)}; it != std::end(index_)) {
+      ++stats_.hits;
+      entries_.splice(std::begin(entries_), entries_, it->second);
+      return it->second->second;
+    }
+    ++stats_.misses;
+  }
+
+  // generate without holding the lock so the workers don't serialize
+  auto map{std::make_shared<HeightMap const>(
+      generate_height_map({chunk_width * offset.x, chunk_depth * offset.y}))};
+
+  std::scoped_lock lock{mutex_};
+  if (auto const it{index_.find(key)}; it != std::end(index_))
+    return it->second->second;
+  entries_.emplace_front(key, map);
+  index_[key] = std::begin(entries_);
+  evict();
+  return map;
+}
+
+void HeightMapCache::set_capacity(long long capacity)
+{
+  std::scoped_lock lock{mutex_};
+  capacity_ = capacity;
+  evict();
+}
+
+HeightMapCache::Stats HeightMapCache::stats() const
+{
+  std::scoped_lock lock{mutex_};
+  return stats_;
+}
+
+void HeightMapCache::evict()
+{
+  while (std::ssize(entries_) > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+HeightMapCache& height_map_cache() noexcept
+{
+  static HeightMapCache cache;
+  return cache;
+}
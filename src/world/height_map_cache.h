@@ -0,0 +1,46 @@
+#pragma once
+
+#include "chunk.h"
+#include "container/hash_map.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+
+// least recently used height maps keyed by chunk offset, safe to share
+// between the chunk streaming workers
+class HeightMapCache {
+public:
+  static constexpr long long default_capacity{1024};
+
+  struct Stats {
+    long long hits;
+    long long misses;
+  };
+
+  explicit HeightMapCache(long long capacity = default_capacity);
+  HeightMapCache(HeightMapCache const&) = delete;
+  HeightMapCache(HeightMapCache&&) = delete;
+  HeightMapCache& operator=(HeightMapCache const&) = delete;
+  HeightMapCache& operator=(HeightMapCache&&) = delete;
+  ~HeightMapCache() = default;
+
+  std::shared_ptr<HeightMap const> get(glm::ivec2 offset);
+
+  void set_capacity(long long capacity);
+
+  Stats stats() const;
+private:
+  using Entry = std::pair<uint64_t, std::shared_ptr<HeightMap const>>;
+
+  void evict();
+
+  mutable std::mutex mutex_{};
+  long long capacity_{};
+  std::list<Entry> entries_{};
+  HashMap<uint64_t, std::list<Entry>::iterator> index_{};
+  Stats stats_{};
+};
+
+HeightMapCache& height_map_cache() noexcept;
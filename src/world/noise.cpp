@@ -0,0 +1,110 @@
+#include "noise.h"
+
+#include "noise_kernel.h"
+
+#if defined(CJCRAFT_NOISE_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+std::int64_t perlin_fbm_sse41(
+    int seed, float const* xs, float const* ys, float* out, std::int64_t n);
+std::int64_t perlin_fbm_avx2(
+    int seed, float const* xs, float const* ys, float* out, std::int64_t n);
+#endif
+
+namespace {
+
+struct Scalar {
+  using Float = float;
+  using Int = std::int32_t;
+
+  static constexpr auto width{1};
+
+  static Float load(float const* p) noexcept { return *p; }
+  static void store(float* p, Float a) noexcept { *p = a; }
+
+  static Float set(float a) noexcept { return a; }
+  static Int set(int a) noexcept { return a; }
+
+  static Float add(Float a, Float b) noexcept { return a + b; }
+  static Float sub(Float a, Float b) noexcept { return a - b; }
+  static Float mul(Float a, Float b) noexcept { return a * b; }
+
+  // wrap around like the vector lanes do
+  static Int add(Int a, Int b) noexcept
+  {
+    return static_cast<Int>(static_cast<std::uint32_t>(a)
+                            + static_cast<std::uint32_t>(b));
+  }
+  static Int mul(Int a, Int b) noexcept
+  {
+    return static_cast<Int>(static_cast<std::uint32_t>(a)
+                            * static_cast<std::uint32_t>(b));
+  }
+  static Int bit_xor(Int a, Int b) noexcept { return a ^ b; }
+  static Int bit_and(Int a, Int b) noexcept { return a & b; }
+  static Int shift_right(Int a, int n) noexcept { return a >> n; }
+
+  static Float to_float(Int a) noexcept { return static_cast<Float>(a); }
+
+  static Int fast_floor(Float a) noexcept
+  {
+    return a >= 0 ? static_cast<Int>(a) : static_cast<Int>(a) - 1;
+  }
+
+  static void gradient(Int index, Float& x, Float& y) noexcept
+  {
+    x = noise_kernel::gradients[index];
+    y = noise_kernel::gradients[index + 1];
+  }
+};
+
+using Batch = std::int64_t (*)(
+    int seed, float const* xs, float const* ys, float* out, std::int64_t n);
+
+Batch select_batch() noexcept
+{
+#if defined(CJCRAFT_NOISE_X86)
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  auto const nb_ids{info[0]};
+  __cpuid(info, 1);
+  auto const sse41{(info[2] & 1 << 19) != 0};
+  // the os has to save the ymm registers too
+  auto const avx{(info[2] & 1 << 27) != 0 && (info[2] & 1 << 28) != 0
+                 && (_xgetbv(0) & 6) == 6};
+  auto avx2{false};
+  if (nb_ids >= 7) {
+    __cpuidex(info, 7, 0);
+    avx2 = avx && (info[1] & 1 << 5) != 0;
+  }
+#else
+  auto const sse41{__builtin_cpu_supports("sse4.1") != 0};
+  auto const avx2{__builtin_cpu_supports("avx2") != 0};
+#endif
+  if (avx2)
+    return perlin_fbm_avx2;
+  if (sse41)
+    return perlin_fbm_sse41;
+#endif
+  return noise_kernel::fbm_batch<Scalar>;
+}
+
+} // namespace
+
+void perlin_fbm(int seed,
+                std::span<float const> xs,
+                std::span<float const> ys,
+                std::span<float> out) noexcept
+{
+  static auto const batch{select_batch()};
+  auto const n{std::ssize(out)};
+  auto const done{batch(seed, std::data(xs), std::data(ys), std::data(out), n)};
+  noise_kernel::fbm_batch<Scalar>(seed,
+                                  std::data(xs) + done,
+                                  std::data(ys) + done,
+                                  std::data(out) + done,
+                                  n - done);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <span>
+
+// perlin fbm with the default FastNoiseLite settings, gives the same values
+// as FastNoiseLite::GetNoise but evaluates a batch of points with sse4.1 or
+// avx2 when the cpu has them
+void perlin_fbm(int seed,
+                std::span<float const> xs,
+                std::span<float const> ys,
+                std::span<float> out) noexcept;
@@ -0,0 +1,100 @@
+#include "noise_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct DistinctGradients {
+  float values[32];
+};
+
+// the first 24 pairs of the table followed by its last 8
+constexpr DistinctGradients distinct_gradients(int component) noexcept
+{
+  DistinctGradients g{};
+  for (auto i{0}; i < 24; ++i)
+    g.values[i] = noise_kernel::gradients[2 * i + component];
+  for (auto i{0}; i < 8; ++i)
+    g.values[24 + i] = noise_kernel::gradients[2 * (120 + i) + component];
+  return g;
+}
+
+constexpr auto gradients_x{distinct_gradients(0)};
+constexpr auto gradients_y{distinct_gradients(1)};
+
+struct Avx2 {
+  using Float = __m256;
+  using Int = __m256i;
+
+  static constexpr auto width{8};
+
+  static Float load(float const* p) noexcept { return _mm256_loadu_ps(p); }
+  static void store(float* p, Float a) noexcept { _mm256_storeu_ps(p, a); }
+
+  static Float set(float a) noexcept { return _mm256_set1_ps(a); }
+  static Int set(int a) noexcept { return _mm256_set1_epi32(a); }
+
+  static Float add(Float a, Float b) noexcept { return _mm256_add_ps(a, b); }
+  static Float sub(Float a, Float b) noexcept { return _mm256_sub_ps(a, b); }
+  static Float mul(Float a, Float b) noexcept { return _mm256_mul_ps(a, b); }
+
+  static Int add(Int a, Int b) noexcept { return _mm256_add_epi32(a, b); }
+  static Int mul(Int a, Int b) noexcept { return _mm256_mullo_epi32(a, b); }
+  static Int bit_xor(Int a, Int b) noexcept { return _mm256_xor_si256(a, b); }
+  static Int bit_and(Int a, Int b) noexcept { return _mm256_and_si256(a, b); }
+  static Int shift_right(Int a, int n) noexcept
+  {
+    return _mm256_sra_epi32(a, _mm_cvtsi32_si128(n));
+  }
+
+  static Float to_float(Int a) noexcept { return _mm256_cvtepi32_ps(a); }
+
+  // truncate, then step down where the input is negative like FastFloor
+  static Int fast_floor(Float a) noexcept
+  {
+    auto const negative{_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ)};
+    return _mm256_add_epi32(_mm256_cvttps_epi32(a),
+                            _mm256_castps_si256(negative));
+  }
+
+  // the table only has 32 distinct pairs, which fit in four registers per
+  // component, so permute them instead of gathering from memory
+  static void gradient(Int index, Float& x, Float& y) noexcept
+  {
+    auto const pair{_mm256_srli_epi32(index, 1)};
+    auto const quotient{
+        _mm256_srli_epi32(_mm256_mullo_epi32(pair, _mm256_set1_epi32(2731)),
+                          16)};
+    auto const rest{_mm256_sub_epi32(
+        pair, _mm256_mullo_epi32(quotient, _mm256_set1_epi32(24)))};
+    auto const distinct{_mm256_add_epi32(
+        rest,
+        _mm256_and_si256(_mm256_cmpgt_epi32(pair, _mm256_set1_epi32(119)),
+                         _mm256_set1_epi32(24)))};
+
+    x = lookup(gradients_x, distinct);
+    y = lookup(gradients_y, distinct);
+  }
+private:
+  static Float lookup(DistinctGradients const& table, Int index) noexcept
+  {
+    auto const part{[&](int i) {
+      return _mm256_permutevar8x32_ps(_mm256_loadu_ps(table.values + 8 * i),
+                                      index);
+    }};
+    // bit 3 and bit 4 of the index pick the register
+    auto const low{_mm256_castsi256_ps(_mm256_slli_epi32(index, 28))};
+    auto const high{_mm256_castsi256_ps(_mm256_slli_epi32(index, 27))};
+    return _mm256_blendv_ps(_mm256_blendv_ps(part(0), part(1), low),
+                            _mm256_blendv_ps(part(2), part(3), low),
+                            high);
+  }
+};
+
+} // namespace
+
+std::int64_t perlin_fbm_avx2(
+    int seed, float const* xs, float const* ys, float* out, std::int64_t n)
+{
+  return noise_kernel::fbm_batch<Avx2>(seed, xs, ys, out, n);
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+// the perlin fbm kernel shared by the scalar, sse4.1 and avx2 translation
+// units, S wraps one lane type and its operations
+
+#include <cstdint>
+
+// the compilers give up inlining the four gradients of a perlin cell, which
+// costs a fair share of the kernel
+#if defined(_MSC_VER)
+#define NOISE_INLINE __forceinline
+#else
+#define NOISE_INLINE [[gnu::always_inline]] inline
+#endif
+
+namespace noise_kernel {
+
+// FastNoiseLite's Gradients2D, indexed by the even hash, every pair below 120
+// repeats the first 24
+inline constexpr float gradients[256]{
+  0.13052619f, 0.9914449f, 0.38268343f, 0.9238795f,
+  0.6087614f, 0.7933533f, 0.7933533f, 0.6087614f,
+  0.9238795f, 0.38268343f, 0.9914449f, 0.13052619f,
+  0.9914449f, -0.13052619f, 0.9238795f, -0.38268343f,
+  0.7933533f, -0.6087614f, 0.6087614f, -0.7933533f,
+  0.38268343f, -0.9238795f, 0.13052619f, -0.9914449f,
+  -0.13052619f, -0.9914449f, -0.38268343f, -0.9238795f,
+  -0.6087614f, -0.7933533f, -0.7933533f, -0.6087614f,
+  -0.9238795f, -0.38268343f, -0.9914449f, -0.13052619f,
+  -0.9914449f, 0.13052619f, -0.9238795f, 0.38268343f,
+  -0.7933533f, 0.6087614f, -0.6087614f, 0.7933533f,
+  -0.38268343f, 0.9238795f, -0.13052619f, 0.9914449f,
+  0.13052619f, 0.9914449f, 0.38268343f, 0.9238795f,
+  0.6087614f, 0.7933533f, 0.7933533f, 0.6087614f,
+  0.9238795f, 0.38268343f, 0.9914449f, 0.13052619f,
+  0.9914449f, -0.13052619f, 0.9238795f, -0.38268343f,
+  0.7933533f, -0.6087614f, 0.6087614f, -0.7933533f,
+  0.38268343f, -0.9238795f, 0.13052619f, -0.9914449f,
+  -0.13052619f, -0.9914449f, -0.38268343f, -0.9238795f,
+  -0.6087614f, -0.7933533f, -0.7933533f, -0.6087614f,
+  -0.9238795f, -0.38268343f, -0.9914449f, -0.13052619f,
+  -0.9914449f, 0.13052619f, -0.9238795f, 0.38268343f,
+  -0.7933533f, 0.6087614f, -0.6087614f, 0.7933533f,
+  -0.38268343f, 0.9238795f, -0.13052619f, 0.9914449f,
+  0.13052619f, 0.9914449f, 0.38268343f, 0.9238795f,
+  0.6087614f, 0.7933533f, 0.7933533f, 0.6087614f,
+  0.9238795f, 0.38268343f, 0.9914449f, 0.13052619f,
+  0.9914449f, -0.13052619f, 0.9238795f, -0.38268343f,
+  0.7933533f, -0.6087614f, 0.6087614f, -0.7933533f,
+  0.38268343f, -0.9238795f, 0.13052619f, -0.9914449f,
+  -0.13052619f, -0.9914449f, -0.38268343f, -0.9238795f,
+  -0.6087614f, -0.7933533f, -0.7933533f, -0.6087614f,
+  -0.9238795f, -0.38268343f, -0.9914449f, -0.13052619f,
+  -0.9914449f, 0.13052619f, -0.9238795f, 0.38268343f,
+  -0.7933533f, 0.6087614f, -0.6087614f, 0.7933533f,
+  -0.38268343f, 0.9238795f, -0.13052619f, 0.9914449f,
+  0.13052619f, 0.9914449f, 0.38268343f, 0.9238795f,
+  0.6087614f, 0.7933533f, 0.7933533f, 0.6087614f,
+  0.9238795f, 0.38268343f, 0.9914449f, 0.13052619f,
+  0.9914449f, -0.13052619f, 0.9238795f, -0.38268343f,
+  0.7933533f, -0.6087614f, 0.6087614f, -0.7933533f,
+  0.38268343f, -0.9238795f, 0.13052619f, -0.9914449f,
+  -0.13052619f, -0.9914449f, -0.38268343f, -0.9238795f,
+  -0.6087614f, -0.7933533f, -0.7933533f, -0.6087614f,
+  -0.9238795f, -0.38268343f, -0.9914449f, -0.13052619f,
+  -0.9914449f, 0.13052619f, -0.9238795f, 0.38268343f,
+  -0.7933533f, 0.6087614f, -0.6087614f, 0.7933533f,
+  -0.38268343f, 0.9238795f, -0.13052619f, 0.9914449f,
+  0.13052619f, 0.9914449f, 0.38268343f, 0.9238795f,
+  0.6087614f, 0.7933533f, 0.7933533f, 0.6087614f,
+  0.9238795f, 0.38268343f, 0.9914449f, 0.13052619f,
+  0.9914449f, -0.13052619f, 0.9238795f, -0.38268343f,
+  0.7933533f, -0.6087614f, 0.6087614f, -0.7933533f,
+  0.38268343f, -0.9238795f, 0.13052619f, -0.9914449f,
+  -0.13052619f, -0.9914449f, -0.38268343f, -0.9238795f,
+  -0.6087614f, -0.7933533f, -0.7933533f, -0.6087614f,
+  -0.9238795f, -0.38268343f, -0.9914449f, -0.13052619f,
+  -0.9914449f, 0.13052619f, -0.9238795f, 0.38268343f,
+  -0.7933533f, 0.6087614f, -0.6087614f, 0.7933533f,
+  -0.38268343f, 0.9238795f, -0.13052619f, 0.9914449f,
+  0.38268343f, 0.9238795f, 0.9238795f, 0.38268343f,
+  0.9238795f, -0.38268343f, 0.38268343f, -0.9238795f,
+  -0.38268343f, -0.9238795f, -0.9238795f, -0.38268343f,
+  -0.9238795f, 0.38268343f, -0.38268343f, 0.9238795f,
+};
+
+inline constexpr auto prime_x{501125321};
+inline constexpr auto prime_y{1136930381};
+
+// the default FastNoiseLite settings
+inline constexpr auto frequency{0.01f};
+inline constexpr auto octaves{3};
+inline constexpr auto lacunarity{2.f};
+inline constexpr auto gain{.5f};
+inline constexpr auto fractal_bounding{1 / 1.75f};
+
+template<typename S>
+NOISE_INLINE typename S::Float
+lerp(typename S::Float a, typename S::Float b, typename S::Float t) noexcept
+{
+  return S::add(a, S::mul(t, S::sub(b, a)));
+}
+
+template<typename S>
+NOISE_INLINE typename S::Float interp_quintic(typename S::Float t) noexcept
+{
+  return S::mul(
+      S::mul(S::mul(t, t), t),
+      S::add(S::mul(t, S::sub(S::mul(t, S::set(6.f)), S::set(15.f))),
+             S::set(10.f)));
+}
+
+template<typename S>
+NOISE_INLINE typename S::Float gradient(typename S::Int seed,
+                                        typename S::Int x_primed,
+                                        typename S::Int y_primed,
+                                        typename S::Float xd,
+                                        typename S::Float yd) noexcept
+{
+  auto hash{S::mul(S::bit_xor(S::bit_xor(seed, x_primed), y_primed),
+                   S::set(0x27d4eb2d))};
+  hash = S::bit_xor(hash, S::shift_right(hash, 15));
+  hash = S::bit_and(hash, S::set(127 << 1));
+
+  typename S::Float xg;
+  typename S::Float yg;
+  S::gradient(hash, xg, yg);
+  return S::add(S::mul(xd, xg), S::mul(yd, yg));
+}
+
+template<typename S>
+NOISE_INLINE typename S::Float
+perlin(typename S::Int seed, typename S::Float x, typename S::Float y) noexcept
+{
+  auto x0{S::fast_floor(x)};
+  auto y0{S::fast_floor(y)};
+
+  auto const xd0{S::sub(x, S::to_float(x0))};
+  auto const yd0{S::sub(y, S::to_float(y0))};
+  auto const xd1{S::sub(xd0, S::set(1.f))};
+  auto const yd1{S::sub(yd0, S::set(1.f))};
+
+  auto const xs{interp_quintic<S>(xd0)};
+  auto const ys{interp_quintic<S>(yd0)};
+
+  x0 = S::mul(x0, S::set(prime_x));
+  y0 = S::mul(y0, S::set(prime_y));
+  auto const x1{S::add(x0, S::set(prime_x))};
+  auto const y1{S::add(y0, S::set(prime_y))};
+
+  auto const xf0{lerp<S>(gradient<S>(seed, x0, y0, xd0, yd0),
+                         gradient<S>(seed, x1, y0, xd1, yd0),
+                         xs)};
+  auto const xf1{lerp<S>(gradient<S>(seed, x0, y1, xd0, yd1),
+                         gradient<S>(seed, x1, y1, xd1, yd1),
+                         xs)};
+  return S::mul(lerp<S>(xf0, xf1, ys), S::set(1.4247691104677813f));
+}
+
+template<typename S>
+typename S::Float
+fbm(int seed, typename S::Float x, typename S::Float y) noexcept
+{
+  x = S::mul(x, S::set(frequency));
+  y = S::mul(y, S::set(frequency));
+
+  auto sum{S::set(0.f)};
+  auto amp{fractal_bounding};
+  for (auto i{0}; i < octaves; ++i) {
+    sum = S::add(sum, S::mul(perlin<S>(S::set(seed + i), x, y), S::set(amp)));
+    x = S::mul(x, S::set(lacunarity));
+    y = S::mul(y, S::set(lacunarity));
+    amp *= gain;
+  }
+  return sum;
+}
+
+// evaluate whole lanes only, return how many points were written
+template<typename S>
+std::int64_t fbm_batch(
+    int seed, float const* xs, float const* ys, float* out, std::int64_t n)
+{
+  auto i{std::int64_t{0}};
+  for (; i + S::width <= n; i += S::width)
+    S::store(out + i, fbm<S>(seed, S::load(xs + i), S::load(ys + i)));
+  return i;
+}
+
+} // namespace noise_kernel
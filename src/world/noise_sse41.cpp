@@ -0,0 +1,59 @@
+#include "noise_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Sse41 {
+  using Float = __m128;
+  using Int = __m128i;
+
+  static constexpr auto width{4};
+
+  static Float load(float const* p) noexcept { return _mm_loadu_ps(p); }
+  static void store(float* p, Float a) noexcept { _mm_storeu_ps(p, a); }
+
+  static Float set(float a) noexcept { return _mm_set1_ps(a); }
+  static Int set(int a) noexcept { return _mm_set1_epi32(a); }
+
+  static Float add(Float a, Float b) noexcept { return _mm_add_ps(a, b); }
+  static Float sub(Float a, Float b) noexcept { return _mm_sub_ps(a, b); }
+  static Float mul(Float a, Float b) noexcept { return _mm_mul_ps(a, b); }
+
+  static Int add(Int a, Int b) noexcept { return _mm_add_epi32(a, b); }
+  static Int mul(Int a, Int b) noexcept { return _mm_mullo_epi32(a, b); }
+  static Int bit_xor(Int a, Int b) noexcept { return _mm_xor_si128(a, b); }
+  static Int bit_and(Int a, Int b) noexcept { return _mm_and_si128(a, b); }
+  static Int shift_right(Int a, int n) noexcept
+  {
+    return _mm_sra_epi32(a, _mm_cvtsi32_si128(n));
+  }
+
+  static Float to_float(Int a) noexcept { return _mm_cvtepi32_ps(a); }
+
+  // truncate, then step down where the input is negative like FastFloor
+  static Int fast_floor(Float a) noexcept
+  {
+    return _mm_add_epi32(
+        _mm_cvttps_epi32(a),
+        _mm_castps_si128(_mm_cmplt_ps(a, _mm_setzero_ps())));
+  }
+
+  static void gradient(Int index, Float& x, Float& y) noexcept
+  {
+    alignas(16) int i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), index);
+    auto const table{noise_kernel::gradients};
+    x = _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+    y = _mm_setr_ps(
+        table[i[0] + 1], table[i[1] + 1], table[i[2] + 1], table[i[3] + 1]);
+  }
+};
+
+} // namespace
+
+std::int64_t perlin_fbm_sse41(
+    int seed, float const* xs, float const* ys, float* out, std::int64_t n)
+{
+  return noise_kernel::fbm_batch<Sse41>(seed, xs, ys, out, n);
+}
@@ -0,0 +1,75 @@
+#include "palette_storage.h"
+
+#include <algorithm>
+#include <gsl/gsl>
+
+PaletteStorage::PaletteStorage(long long size, BlockType block)
+    : size_{size}, palette_{block}
+{
+}
+
+void PaletteStorage::set(long long i, BlockType block)
+{
+  auto const index{get_index(block)};
+  if (width_ != 0)
+    set_bits(i, index);
+}
+
+void PaletteStorage::fill(long long first, long long last, BlockType block)
+{
+  if (first == 0 && last == size_) {
+    palette_.assign(1, block);
+    width_ = 0;
+    words_ = {};
+    return;
+  }
+
+  auto const index{get_index(block)};
+  if (width_ == 0)
+    return;
+
+  // the blocks between the partial words at both ends are written a whole
+  // word at a time
+  auto const per_word{word_bits / width_};
+  auto pattern{uint64_t{0}};
+  for (auto k{0}; k < per_word; ++k)
+    pattern |= uint64_t{index} << k * width_;
+
+  for (; first < last && first % per_word != 0; ++first)
+    set_bits(first, index);
+  for (; first + per_word <= last; first += per_word)
+    words_[first / per_word] = pattern;
+  for (; first < last; ++first)
+    set_bits(first, index);
+}
+
+long long PaletteStorage::get_memory_usage() const noexcept
+{
+  return gsl::narrow_cast<long long>(std::size(words_) * sizeof(uint64_t)
+                                     + std::size(palette_)
+                                           * sizeof(BlockType));
+}
+
+unsigned PaletteStorage::get_index(BlockType block)
+{
+  if (auto const it{std::ranges::find(palette_, block)};
+      it != std::end(palette_))
+    return gsl::narrow_cast<unsigned>(it - std::begin(palette_));
+
+  palette_.push_back(block);
+  if (std::ssize(palette_) > 1ll << width_)
+    grow();
+  return gsl::narrow_cast<unsigned>(std::size(palette_) - 1);
+}
+
+void PaletteStorage::grow()
+{
+  auto const width{width_ == 0 ? 1 : width_ * 2};
+  std::vector<uint64_t> words((size_ * width + word_bits - 1) / word_bits);
+  for (long long i{0}; i < size_; ++i) {
+    auto const bit{i * width};
+    words[bit / word_bits] |= uint64_t{get_bits(i)} << bit % word_bits;
+  }
+  width_ = width;
+  words_ = std::move(words);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "block.h"
+#include "container/vector.h"
+
+#include <cstdint>
+#include <vector>
+
+// a run of blocks stored as indices into the few block types it holds, the
+// indices are packed into words and widen as the palette grows
+class PaletteStorage {
+public:
+  PaletteStorage() = default;
+  explicit PaletteStorage(long long size, BlockType block = BlockType::air);
+
+  BlockType get(long long i) const noexcept
+  {
+    return palette_[get_bits(i)];
+  }
+
+  void set(long long i, BlockType block);
+
+  // set the blocks from first up to last
+  void fill(long long first, long long last, BlockType block);
+
+  long long size() const noexcept { return size_; }
+
+  // a single block type and no index words
+  bool is_uniform() const noexcept { return width_ == 0; }
+
+  // bytes held on the heap
+  long long get_memory_usage() const noexcept;
+private:
+  static constexpr int word_bits{64};
+
+  // the palette index of a block, added if it is new
+  unsigned get_index(BlockType block);
+
+  // double the bits per block and repack every index
+  void grow();
+
+  unsigned get_bits(long long i) const noexcept
+  {
+    if (width_ == 0)
+      return 0;
+    auto const bit{i * width_};
+    return words_[bit / word_bits] >> bit % word_bits & ((1u << width_) - 1);
+  }
+
+  void set_bits(long long i, unsigned index) noexcept
+  {
+    auto const bit{i * width_};
+    auto& word{words_[bit / word_bits]};
+    auto const mask{(uint64_t{1} << width_) - 1};
+    word = (word & ~(mask << bit % word_bits))
+         | uint64_t{index} << bit % word_bits;
+  }
+
+  long long size_{};
+  // a power of two so an index never straddles two words, 0 while the
+  // storage holds a single block type
+  int width_{};
+  Vector<BlockType> palette_{};
+  std::vector<uint64_t> words_{};
+};
@@ -0,0 +1,67 @@
+#include "stream.h"
+
+#include <exception>
+#include <tuple>
+
+ChunkStreamer::ChunkStreamer(unsigned nb_workers)
+{
+  workers_.reserve(nb_workers);
+  for (auto i{0u}; i < nb_workers; ++i)
+    workers_.emplace_back([this](std::stop_token stop) { work(stop); });
+}
+
+void ChunkStreamer::request(glm::ivec2 offset, unsigned ticket, Job job)
+{
+  {
+    std::scoped_lock lock{mutex_};
+    requests_.push_back({offset, ticket, std::move(job)});
+  }
+  cv_.notify_one();
+}
+
+void ChunkStreamer::retain(std::function<bool(glm::ivec2)> const& pred)
+{
+  std::scoped_lock lock{mutex_};
+  std::erase_if(requests_, [&](Request const& r) { return !pred(r.offset); });
+  std::erase_if(meshes_, [&](ChunkMesh const& m) { return !pred(m.offset); });
+}
+
+std::optional<ChunkMesh> ChunkStreamer::poll(long long max_size)
+{
+  std::scoped_lock lock{mutex_};
+  if (std::empty(meshes_)
+      || gsl::narrow_cast<long long>(std::size(meshes_.front().faces)
+                                     * sizeof(Face))
+             > max_size)
+    return std::nullopt;
+  auto mesh{std::move(meshes_.front())};
+  meshes_.pop_front();
+  return mesh;
+}
+
+void ChunkStreamer::work(std::stop_token stop)
+{
+  while (true) {
+    Request r;
+    {
+      std::unique_lock lock{mutex_};
+      if (!cv_.wait(lock, stop, [this] { return !std::empty(requests_); }))
+        return;
+      r = std::move(requests_.front());
+      requests_.pop_front();
+    }
+
+    // a throw would end the program on this thread, the owner is told
+    // instead
+    ChunkMesh mesh{r.offset, r.ticket};
+    try {
+      std::tie(mesh.faces, mesh.counts) = r.job();
+    }
+    catch (std::exception const& e) {
+      mesh.error = e.what();
+    }
+
+    std::scoped_lock lock{mutex_};
+    meshes_.push_back(std::move(mesh));
+  }
+}
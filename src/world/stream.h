@@ -0,0 +1,66 @@
+#pragma once
+
+#include "block.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct ChunkMesh {
+  glm::ivec2 offset;
+  unsigned ticket;
+  // the faces of each pass, one after another
+  std::vector<Face> faces;
+  PassCounts counts;
+  // what went wrong if the job threw, the mesh is empty then
+  std::string error;
+};
+
+// generates chunk meshes on background threads, the owner polls the finished
+// meshes and decides when to upload them
+class ChunkStreamer {
+public:
+  using Job = std::function<std::pair<std::vector<Face>, PassCounts>()>;
+
+  explicit ChunkStreamer(
+      unsigned nb_workers = std::max(std::thread::hardware_concurrency(), 2u)
+                            - 1);
+  ChunkStreamer(ChunkStreamer const&) = delete;
+  ChunkStreamer(ChunkStreamer&&) = delete;
+
+  ChunkStreamer& operator=(ChunkStreamer const&) = delete;
+  ChunkStreamer& operator=(ChunkStreamer&&) = delete;
+
+  ~ChunkStreamer() = default;
+
+  void request(glm::ivec2 offset, unsigned ticket, Job job);
+
+  // drop the queued requests that are no longer wanted
+  void retain(std::function<bool(glm::ivec2)> const& pred);
+
+  // pop a finished mesh if it is not larger than max_size bytes
+  std::optional<ChunkMesh> poll(long long max_size);
+private:
+  struct Request {
+    glm::ivec2 offset;
+    unsigned ticket;
+    Job job;
+  };
+
+  void work(std::stop_token stop);
+
+  std::mutex mutex_{};
+  std::condition_variable_any cv_{};
+  std::deque<Request> requests_{};
+  std::deque<ChunkMesh> meshes_{};
+
+  std::vector<std::jthread> workers_{};
+};
@@ -1,25 +1,23 @@
 #include "chunk.h"
-
-#include "FastNoiseLite/FastNoiseLite.h"
+#include "noise.h"
 
 #include <gsl/gsl>
 #include <random>
 
 HeightMap generate_height_map(glm::ivec2 offset)
 {
-  static auto const noise{[] {
-    FastNoiseLite noise{1};
-    noise.SetSeed(gsl::narrow_cast<int>(std::random_device{}()));
-    noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    return noise;
-  }()};
+  static auto const seed{gsl::narrow_cast<int>(std::random_device{}())};
 
   constexpr auto frequency{0.5f};
+  std::array<float, chunk_depth + 1> xs;
+  std::array<float, chunk_depth + 1> ys;
+  for (auto j{0}; j < chunk_depth + 1; ++j)
+    ys[j] = frequency * (j + offset.y);
+
   HeightMap map(chunk_width + 1);
-  for (auto i{0}; i < chunk_width + 1; ++i)
-    for (auto j{0}; j < chunk_depth + 1; ++j)
-      map[i][j] = noise.GetNoise(frequency * (i + offset.x),
-                                 frequency * (j + offset.y));
+  for (auto i{0}; i < chunk_width + 1; ++i) {
+    xs.fill(frequency * (i + offset.x));
+    perlin_fbm(seed, xs, ys, map[i]);
+  }
   return map;
 }
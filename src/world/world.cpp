@@ -1,935 +1,1161 @@
 #include "world.h"
+#include "height_map_cache.h"
+#include "math/math.h"
 
-#include <execution>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <numeric>
+#include <utility>
+
+namespace {
+#if defined(CJCRAFT_VERTEX_PULLING)
+  constexpr auto chunk_buffer_usage{vk::BufferUsageFlagBits::eTransferSrc
+                                    | vk::BufferUsageFlagBits::eTransferDst
+                                    | vk::BufferUsageFlagBits::eStorageBuffer};
+#else
+  constexpr auto chunk_buffer_usage{vk::BufferUsageFlagBits::eTransferSrc
+                                    | vk::BufferUsageFlagBits::eTransferDst
+                                    | vk::BufferUsageFlagBits::eVertexBuffer};
+#endif
+  // resizable BAR, the host writes hot meshes where the device reads them
+  constexpr vk::MemoryPropertyFlags direct_chunk_memory{
+      vk::MemoryPropertyFlagBits::eHostVisible
+      | vk::MemoryPropertyFlagBits::eHostCoherent
+      | vk::MemoryPropertyFlagBits::eDeviceLocal};
+
+  // whether the first memory type with property, the one BufferManager
+  // takes, sits in a heap of size bytes or more, without resizable BAR the
+  // host visible device local heap is a window far smaller than the chunk
+  // block
+  bool has_memory_type(vk::MemoryPropertyFlags property,
+                       long long size) noexcept
+  {
+    auto const& memory{g_context.get_gpu_memory_properties()};
+    for (auto i{0u}; i < memory.memoryTypeCount; ++i)
+      if ((memory.memoryTypes[i].propertyFlags & property) == property)
+        return memory.memoryHeaps[memory.memoryTypes[i].heapIndex].size
+            >= gsl::narrow_cast<unsigned long long>(size);
+    return false;
+  }
 
-World::World(vk::CommandBuffer command,
-             Buffer staging_buffer,
-             int render_distance)
-    : side_{render_distance}, buffers_(side_ * side_)
-{
-  std::span<Face> staging_view{
-      static_cast<Face*>(staging_buffer.data),
-      gsl::narrow_cast<unsigned long long>(staging_buffer.size)};
-  auto it{std::begin(staging_view)};
+  // whether two chunk ranges are the same one of the block, an empty range
+  // is none
+  bool same_range(Buffer const& a, Buffer const& b) noexcept
+  {
+    return a.handle && a.handle == b.handle && a.offset == b.offset;
+  }
 
-  // create cold chunk
-  for (auto i{0}; i < side_; ++i)
-    for (auto j{0}; j < side_; ++j) {
-      // skip if this chunk is around the player
-      if ((i == (side_ - 1) / 2 || i == side_ / 2)
-          && (j == (side_ - 1) / 2 || j == side_ / 2))
-        continue;
+  // matches local_size_x of cull.comp
+  constexpr auto cull_group_size{64};
+
+  // a hot mesh with a larger share of empty face slots gets compacted
+  constexpr auto max_hole_ratio{0.25};
+
+  long long get_chunk_block_size() noexcept
+  {
+#if defined(CJCRAFT_VERTEX_PULLING)
+    // a single storage buffer descriptor has to reach every chunk
+    return std::min<long long>(
+        2e9, g_context.get_gpu_properties().limits.maxStorageBufferRange);
+#else
+    return 2e9;
+#endif
+  }
 
-      auto const faces{create_chunk({i, j})};
-      std::ranges::copy(faces, it);
-
-      buffers_[side_ * i + j] =
-          buffer_manager_.create(vk::BufferUsageFlagBits::eTransferSrc
-                                     | vk::BufferUsageFlagBits::eTransferDst
-                                     | vk::BufferUsageFlagBits::eVertexBuffer,
-                                 vk::MemoryPropertyFlagBits::eHostVisible
-                                     | vk::MemoryPropertyFlagBits::eHostCoherent
-                                     | vk::MemoryPropertyFlagBits::eDeviceLocal,
-                                 300'000,
-                                 2e9);
-      copy_buffer(command,
-                  {staging_buffer.handle,
-                   gsl::narrow_cast<long long>(staging_buffer.offset
-                                               + (it - std::begin(staging_view))
-                                                     * sizeof(Face)),
-                   gsl::narrow_cast<long long>(std::size(faces) * sizeof(Face)),
-                   nullptr},
-                  buffers_[side_ * i + j]);
-      buffers_[side_ * i + j].size = std::size(faces) * sizeof(Face);
-      it += std::size(faces);
-    }
+  // chunk buffer offsets and sizes in vertices of the chunk pipeline
+  unsigned to_vertices(long long bytes) noexcept
+  {
+#if defined(CJCRAFT_VERTEX_PULLING)
+    return gsl::narrow_cast<unsigned>(bytes / sizeof(Face)
+                                      * Face::nb_vertices);
+#else
+    return gsl::narrow_cast<unsigned>(bytes / sizeof(Vertex));
+#endif
+  }
 
-  for (auto i{0}; i < 2; ++i)
-    for (auto j{0}; j < 2; ++j) {
-      auto [f, m, t]{create_hot_chunk({side_ / 2 - 1 + i, side_ / 2 - 1 + j})};
-
-      buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j] =
-          buffer_manager_.create(vk::BufferUsageFlagBits::eTransferSrc
-                                     | vk::BufferUsageFlagBits::eTransferDst
-                                     | vk::BufferUsageFlagBits::eVertexBuffer,
-                                 vk::MemoryPropertyFlagBits::eHostVisible
-                                     | vk::MemoryPropertyFlagBits::eHostCoherent
-                                     | vk::MemoryPropertyFlagBits::eDeviceLocal,
-                                 300'000,
-                                 2e9);
-      buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j].size =
-          std::size(f) * sizeof(Face);
-      std::ranges::copy(
-          f,
-          static_cast<Face*>(
-              buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j]
-                  .data));
-      terrains_[i][j] = std::move(t);
-      maps_[i][j] = std::move(m);
-    }
+  // key of the edit logs and the hot chunks
+  uint64_t get_chunk_key(glm::ivec2 offset) noexcept
+  {
+    return static_cast<uint64_t>(static_cast<uint32_t>(offset.x)) << 32
+         | static_cast<uint32_t>(offset.y);
+  }
+
+  // key of a block inside its chunk
+  unsigned get_block_key(glm::ivec3 pos) noexcept
+  {
+    return gsl::narrow_cast<unsigned>(pos.x << 16 | pos.y << 8 | pos.z);
+  }
+
+  // the cutout and water faces of a hot chunk
+  long long count_later_faces(HotChunk const& chunk) noexcept
+  {
+    auto count{0ll};
+    for (auto&& pass : chunk.later)
+      for (auto&& faces : pass)
+        count += std::ssize(faces);
+    return count;
+  }
+
+  // the heap footprint of a hot chunk
+  long long get_memory_usage(HotChunk const& chunk) noexcept
+  {
+    auto later{0ll};
+    for (auto&& pass : chunk.later)
+      for (auto&& faces : pass)
+        later += gsl::narrow_cast<long long>(faces.capacity() * sizeof(Face));
+    return chunk.terrain.get_memory_usage()
+         + gsl::narrow_cast<long long>(chunk.mesh.capacity() * sizeof(Face))
+         + later;
+  }
+} // namespace
+
+World::World(int render_distance,
+             bool greedy_meshing,
+             long long hot_memory_cap,
+             bool direct_chunk_writes)
+    : side_{render_distance},
+      greedy_meshing_{greedy_meshing},
+      chunk_memory_{direct_chunk_writes
+                            && has_memory_type(direct_chunk_memory,
+                                               get_chunk_block_size())
+                        ? direct_chunk_memory
+                        : vk::MemoryPropertyFlagBits::eDeviceLocal},
+      buffers_(side_ * side_),
+      pass_counts_(side_ * side_),
+      shown_(side_ * side_),
+      tickets_(side_ * side_),
+      heights_(side_ * side_, full_height_range),
+      hot_memory_cap_{hot_memory_cap}
+{
+  // keep the height map of every chunk in view plus a row in flight, so
+  // promoting a chunk to hot does not generate it again
+  height_map_cache().set_capacity(side_ * side_ + side_);
+
+  // every chunk mesh is a range of one block, sized to its faces, the block
+  // is opened up front so it can be bound before the first mesh arrives, in
+  // plain device local memory with the staging ring if the direct one has no
+  // room for it
+  auto const create_block{[this] {
+    return buffer_manager_.create(chunk_buffer_usage,
+                                  chunk_memory_,
+                                  chunk_buffer_size,
+                                  get_chunk_block_size());
+  }};
+  auto block{Buffer{}};
+  try {
+    block = create_block();
+  }
+  catch (std::runtime_error const&) {
+    if (chunk_memory_ == vk::MemoryPropertyFlagBits::eDeviceLocal)
+      throw;
+    chunk_memory_ = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    block = create_block();
+  }
+  face_buffer_ = block.handle;
+  buffer_manager_.free(block);
+
+  // every chunk starts cold, the voxels are generated when first touched
+  std::vector<glm::ivec2> chunks;
+  for (auto i{0}; i < side_; ++i)
+    for (auto j{0}; j < side_; ++j)
+      chunks.push_back({i, j});
+  // the meshes are streamed in like those of a move, the ones around the
+  // camera first
+  std::ranges::sort(chunks, {}, [this](glm::ivec2 offset) {
+    auto const d{2 * offset - (side_ - 1)};
+    return d.x * d.x + d.y * d.y;
+  });
+  for (auto&& offset : chunks)
+    request_chunk(offset);
+
+  auto const info_size{gsl::narrow_cast<long long>(side_ * side_
+                                                   * sizeof(ChunkInfo))};
+  // a list of commands per pass, each with a count, and the chunks drawn
+  auto const command_size{gsl::narrow_cast<long long>(
+      nb_mesh_passes * side_ * side_ * sizeof(vk::DrawIndirectCommand))};
+  for (gsl::index i{0}; i < max_in_flight; ++i) {
+    chunk_infos_[i] = buffer_manager_.create(
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible
+            | vk::MemoryPropertyFlagBits::eHostCoherent,
+        info_size,
+        std::max(info_size, BufferManager::default_block_size));
+    // the counts are cleared with a fill, the commands share their usage so
+    // both come from the same block
+    draw_commands_[i] = buffer_manager_.create(
+        vk::BufferUsageFlagBits::eStorageBuffer
+            | vk::BufferUsageFlagBits::eIndirectBuffer
+            | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        command_size,
+        std::max(command_size, BufferManager::default_block_size));
+    draw_counts_[i] = buffer_manager_.create(
+        vk::BufferUsageFlagBits::eStorageBuffer
+            | vk::BufferUsageFlagBits::eIndirectBuffer
+            | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        (nb_mesh_passes + 1) * sizeof(unsigned));
+    count_readbacks_[i] = buffer_manager_.create(
+        vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible
+            | vk::MemoryPropertyFlagBits::eHostCoherent,
+        sizeof(unsigned));
+    *static_cast<unsigned*>(count_readbacks_[i].data) = 0;
+  }
 }
 
-void World::draw(vk::CommandBuffer command,
+void World::cull(vk::CommandBuffer command,
+                 gsl::index frame,
                  vk::PipelineLayout layout,
-                 glm::vec2 pos,
-                 glm::vec2 front) const
+                 glm::mat4 const& view_proj,
+                 glm::vec3 eye)
 {
+  // the fence of this frame is signaled, so its infos are not read anymore
+  // and the count of its last cull has landed
+  cull_stats_ = {*static_cast<unsigned const*>(count_readbacks_[frame].data),
+                 cull_totals_[frame]};
+  cull_totals_[frame] = 0;
+
+  // and the ranges only the frames up to its last use drew are free
+  std::erase_if(retired_, [this](std::pair<Buffer, long long> const& r) {
+    if (r.second > frame_count_ - max_in_flight)
+      return false;
+    buffer_manager_.free(r.first);
+    return true;
+  });
+  ++frame_count_;
+
+  auto const infos{static_cast<ChunkInfo*>(chunk_infos_[frame].data)};
+  // water is blended without writing depth, so the chunks holding some are
+  // drawn back to front, the faces inside a chunk are not sorted, generated
+  // water is a single flat layer whose faces never cover one another
+  std::vector<std::pair<float, gsl::index>> wet;
   for (auto i{0}; i < side_; ++i)
     for (auto j{0}; j < side_; ++j) {
-      PushConstant pd{
-          {(offset_.x + i) * chunk_width, 0, (offset_.y + j) * chunk_depth}};
-      auto diff{
-          glm::normalize(glm::vec2{pd.offset.x + chunk_width / 2 - pos.x,
-                                   pd.offset.z + chunk_depth / 2 - pos.y})};
-
-      if (diff.x * front.x + diff.y * front.y < 0.2
-          && (pd.offset.x - pos.x) * (pd.offset.x - pos.x)
-                     + (pd.offset.z - pos.y) * (pd.offset.z - pos.y)
-                 > 80'000)
-        continue;
-
-      command.pushConstants(layout,
-                            vk::ShaderStageFlagBits::eVertex
-                                | vk::ShaderStageFlagBits::eFragment,
-                            0,
-                            sizeof(PushConstant),
-                            &pd);
-      command.bindVertexBuffers(
-          0u, buffers_[side_ * i + j].handle, buffers_[side_ * i + j].offset);
-      command.draw(buffers_[side_ * i + j].size / sizeof(Vertex), 1u, 0u, 0u);
+      auto const slot{get_slot(offset_ + glm::ivec2{i, j})};
+      glm::vec4 const origin{
+          (offset_.x + i) * chunk_width, 0, (offset_.y + j) * chunk_depth, 1};
+      // the chunk covers one more block than its width, its border column
+      // holds the faces shared with the next chunk
+      auto const [low, high]{heights_[slot]};
+      // a chunk still streaming in has no vertices and is skipped
+      auto const& [buffer, counts]{
+          shown_[slot] ? *shown_[slot]
+                       : std::pair{buffers_[slot], pass_counts_[slot]}};
+      auto const [opaque, cutout, water]{counts};
+      auto const face_size{gsl::narrow_cast<long long>(sizeof(Face))};
+      infos[slot] = {origin,
+                     origin + glm::vec4{0, low, 0, 0},
+                     origin
+                         + glm::vec4{chunk_width + 1, high, chunk_depth + 1, 0},
+                     to_vertices(buffer.offset),
+                     {to_vertices(opaque * face_size),
+                      to_vertices(cutout * face_size),
+                      to_vertices(water * face_size)}};
+      if (buffer.size != 0)
+        ++cull_totals_[frame];
+      if (water != 0) {
+        auto const to_center{glm::vec3{origin.x + (chunk_width + 1) * 0.5f,
+                                       (low + high) * 0.5f,
+                                       origin.z + (chunk_depth + 1) * 0.5f}
+                             - eye};
+        wet.push_back({glm::dot(to_center, to_center), slot});
+      }
     }
+  std::ranges::sort(wet, std::greater{});
+  for (gsl::index rank{0}; rank < std::ssize(wet); ++rank)
+    infos[wet[rank].second].water_rank = gsl::narrow_cast<unsigned>(rank);
+
+  command.fillBuffer(draw_counts_[frame].handle,
+                     draw_counts_[frame].offset,
+                     draw_counts_[frame].size,
+                     0u);
+  command.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eComputeShader,
+      {},
+      {{.srcAccessMask{vk::AccessFlagBits::eTransferWrite},
+        .dstAccessMask{vk::AccessFlagBits::eShaderRead
+                       | vk::AccessFlagBits::eShaderWrite}}},
+      {},
+      {});
+
+  CullConstant const constant{frustum_planes(view_proj),
+                              gsl::narrow_cast<unsigned>(side_ * side_)};
+  command.pushConstants(layout,
+                        vk::ShaderStageFlagBits::eCompute,
+                        0,
+                        sizeof(CullConstant),
+                        &constant);
+  command.dispatch(
+      gsl::narrow_cast<unsigned>((side_ * side_ + cull_group_size - 1)
+                                 / cull_group_size),
+      1u,
+      1u);
+
+  command.pipelineBarrier(
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eDrawIndirect
+          | vk::PipelineStageFlagBits::eTransfer,
+      {},
+      {{.srcAccessMask{vk::AccessFlagBits::eShaderWrite},
+        .dstAccessMask{vk::AccessFlagBits::eIndirectCommandRead
+                       | vk::AccessFlagBits::eTransferRead}}},
+      {},
+      {});
+
+  // keep the count of chunks drawn, after those of the passes, for
+  // get_cull_stats
+  copy_buffer(command,
+              {draw_counts_[frame].handle,
+               draw_counts_[frame].offset + nb_mesh_passes * sizeof(unsigned),
+               sizeof(unsigned),
+               nullptr},
+              count_readbacks_[frame]);
+  command.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eHost,
+      {},
+      {{.srcAccessMask{vk::AccessFlagBits::eTransferWrite},
+        .dstAccessMask{vk::AccessFlagBits::eHostRead}}},
+      {},
+      {});
 }
 
-bool World::place_block(BlockType block, FaceType face, glm::ivec3 pos)
+void World::draw(vk::CommandBuffer command,
+                 gsl::index frame,
+                 MeshPass pass) const
 {
-  // decide the face is located at which one of the four hot chunk
-  auto i{0};
-  if (pos.x <= offset_.x * chunk_width + chunk_width * (side_ / 2 - 1) + 1
-      || pos.x >= offset_.x * chunk_width + chunk_width * (side_ / 2 + 1) - 2
-      || pos.y < 0 || pos.y >= chunk_height)
-    return false;
-  else if (pos.x >= offset_.x * chunk_width + chunk_width * (side_ / 2)) {
-    i = 1;
-    pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2);
-  }
-  else
-    pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2 - 1);
-  auto j{0};
-  if (pos.z <= offset_.y * chunk_depth + chunk_depth * (side_ / 2 - 1)
-      || pos.z >= offset_.y * chunk_depth + chunk_depth * (side_ / 2 + 1) - 1)
-    return false;
-  else if (pos.z >= offset_.y * chunk_depth + chunk_depth * (side_ / 2)) {
-    j = 1;
-    pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2);
-  }
-  else
-    pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2 - 1);
+#if !defined(CJCRAFT_VERTEX_PULLING)
+  command.bindVertexBuffers(0u, face_buffer_, vk::DeviceSize{0});
+#endif
+  // the instance index of each draw is its chunk slot
+  auto const p{static_cast<int>(pass)};
+  command.drawIndirectCount(
+      draw_commands_[frame].handle,
+      gsl::narrow_cast<unsigned long long>(
+          draw_commands_[frame].offset
+          + p * side_ * side_ * sizeof(vk::DrawIndirectCommand)),
+      draw_counts_[frame].handle,
+      gsl::narrow_cast<unsigned long long>(draw_counts_[frame].offset
+                                           + p * sizeof(unsigned)),
+      gsl::narrow_cast<unsigned>(side_ * side_),
+      sizeof(vk::DrawIndirectCommand));
+}
 
-  if (terrains_[i][j][pos.x][pos.z][pos.y] == BlockType::air)
+bool World::place_block(BlockType block, FaceType face, glm::ivec3 pos)
+{
+  evict_hot_chunks();
+  auto [chunk, local]{locate(pos)};
+  if (!is_editable(chunk) || local.y < 0 || local.y >= chunk_height
+      || get_hot_chunk(chunk).terrain.get(local)
+             == BlockType::air)
     return false;
 
   // the actual position of the block
   switch (face) {
   case FaceType::up:
-    --pos.y;
-    if (pos.y < 0)
+    --local.y;
+    if (local.y < 0)
       return false;
     break;
   case FaceType::down:
-    ++pos.y;
-    if (pos.y < chunk_height)
+    ++local.y;
+    if (local.y < chunk_height)
       return false;
     break;
   case FaceType::left:
-    --pos.x;
-    if (pos.x < 0) {
-      --i;
-      pos.x = chunk_width - 1;
+    --local.x;
+    if (local.x < 0) {
+      --chunk.x;
+      local.x = chunk_width - 1;
     }
     break;
   case FaceType::right:
-    ++pos.x;
-    if (pos.x == chunk_width) {
-      ++i;
-      pos.x = 0;
+    ++local.x;
+    if (local.x == chunk_width) {
+      ++chunk.x;
+      local.x = 0;
     }
     break;
   case FaceType::front:
-    --pos.z;
-    if (pos.z < 0) {
-      --j;
-      pos.z = chunk_depth - 1;
+    --local.z;
+    if (local.z < 0) {
+      --chunk.y;
+      local.z = chunk_depth - 1;
     }
     break;
   case FaceType::back:
-    ++pos.z;
-    if (pos.z == chunk_depth) {
-      ++j;
-      pos.z = 0;
+    ++local.z;
+    if (local.z == chunk_depth) {
+      ++chunk.y;
+      local.z = 0;
     }
     break;
   }
 
-  if (terrains_[i][j][pos.x][pos.z][pos.y] != BlockType::air)
+  if (!is_editable(chunk))
+    return false;
+  if (get_hot_chunk(chunk).terrain.get(local) != BlockType::air)
     return false;
 
   // place block
-  terrains_[i][j][pos.x][pos.z][pos.y] = block;
-  block_mods_[static_cast<uint64_t>(offset_.x + (side_ - 1) / 2 + i) << 32
-              | static_cast<uint64_t>(offset_.y + (side_ - 1) / 2 + j)]
-      .push_back({block, static_cast<glm::u8vec3>(pos)});
-  place_block_help(i, j, block, face, pos);
+  set_block(chunk, local, block);
 
   return true;
 }
 
 bool World::destroy_block(FaceType face, glm::ivec3 pos)
 {
-  auto i{0};
-  if (pos.x <= offset_.x * chunk_width + chunk_width * (side_ / 2 - 1)
-      || pos.x >= offset_.x * chunk_width + chunk_width * (side_ / 2 + 1) - 1
-      || pos.y < 0 || pos.y >= chunk_height)
-    return false;
-  else if (pos.x >= offset_.x * chunk_width + chunk_width * (side_ / 2)) {
-    i = 1;
-    pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2);
-  }
-  else
-    pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2 - 1);
-  auto j{0};
-  if (pos.z <= offset_.y * chunk_depth + chunk_depth * (side_ / 2 - 1)
-      || pos.z >= offset_.y * chunk_depth + chunk_depth * (side_ / 2 + 1) - 1)
+  evict_hot_chunks();
+  auto const [chunk, local]{locate(pos)};
+  if (!is_editable(chunk) || local.y < 0 || local.y >= chunk_height)
     return false;
-  else if (pos.z >= offset_.y * chunk_depth + chunk_depth * (side_ / 2)) {
-    j = 1;
-    pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2);
-  }
-  else
-    pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2 - 1);
 
-  if (terrains_[i][j][pos.x][pos.z][pos.y] == BlockType::air
-      || terrains_[i][j][pos.x][pos.z][pos.y] == BlockType::bedrock)
+  auto const& terrain{get_hot_chunk(chunk).terrain};
+  if (terrain.get(local) == BlockType::air
+      || terrain.get(local) == BlockType::bedrock)
     return false;
 
-  terrains_[i][j][pos.x][pos.z][pos.y] = BlockType::air;
-  block_mods_[static_cast<uint64_t>(offset_.x + (side_ - 1) / 2 + i) << 32
-              | static_cast<uint64_t>(offset_.y + (side_ - 1) / 2 + j)]
-      .push_back({BlockType::air, static_cast<glm::u8vec3>(pos)});
-  destroy_block_help(i, j, face, pos);
+  set_block(chunk, local, BlockType::air);
 
   return true;
 }
 
-bool World::move(vk::CommandBuffer command,
-                 Buffer staging_buffer,
-                 glm::ivec2 position)
+bool World::move(glm::ivec2 position)
 {
-  std::span<Face> staging_view{
-      static_cast<Face*>(staging_buffer.data),
-      gsl::narrow_cast<unsigned long long>(staging_buffer.size)};
-  auto staging_it{std::begin(staging_view)};
-
   if (position.x > offset_.x + side_ / 2) {
-    for (auto i{0}; i < side_; ++i) {
-      if (auto it{mods_.find(static_cast<uint64_t>(offset_.x + side_) << 32
-                             | static_cast<uint64_t>(offset_.y + i))};
-          it != std::end(mods_)) {
-        auto [f, m, t]{create_hot_chunk({offset_.x + side_, offset_.y + i})};
-        std::ranges::copy(f, staging_it);
-
-        Buffer b{nullptr,
-                 0,
-                 static_cast<int64_t>(std::size(f) * sizeof(Face)),
-                 static_cast<Face*>(staging_buffer.data)
-                     + (staging_it - std::begin(staging_view))};
-        Vector<unsigned> free;
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(b, m, free, block, face, pos);
-            break;
-          case Operation::destroy:
-            destroy_face(b, m, free, face, pos);
-            break;
-          }
-
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             b.size,
-             staging_buffer.data},
-            buffers_[i]);
-        buffers_[i].size = b.size;
-        staging_it += b.size / sizeof(Face);
-      }
-      else {
-        auto const f{create_chunk({offset_.x + side_, offset_.y + i})};
-        std::ranges::copy(f, staging_it);
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             gsl::narrow_cast<long long>(std::size(f) * sizeof(Face)),
-             staging_buffer.data},
-            buffers_[i]);
-        buffers_[i].size = std::size(f) * sizeof(Face);
-        staging_it += std::size(f);
-      }
-    }
-
-    for (auto i{0}; i < side_ - 1; ++i)
-      for (auto j{0}; j < side_; ++j)
-        std::swap(buffers_[i * side_ + j], buffers_[(i + 1) * side_ + j]);
-
-    for (auto i{0}; i < 2; ++i) {
-      auto [f, m, t]{create_hot_chunk(
-          {offset_.x + side_ / 2 + 1, offset_.y + side_ / 2 - 1 + i})};
-      std::ranges::copy(
-          f,
-          static_cast<Face*>(
-              buffers_[side_ * ((side_ - 1) / 2 + 1) + (side_ - 1) / 2 + i]
-                  .data));
-      buffers_[side_ * ((side_ - 1) / 2 + 1) + (side_ - 1) / 2 + i].size =
-          std::size(f) * sizeof(Face);
-
-      Vector<unsigned> free;
-      if (auto it{mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 + 1) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 - 1 + i))};
-          it != std::end(mods_))
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(
-                buffers_[side_ * ((side_ - 1) / 2 + 1) + (side_ - 1) / 2 + i],
-                m,
-                free,
-                block,
-                face,
-                pos);
-            break;
-          case Operation::destroy:
-            destroy_face(
-                buffers_[side_ * ((side_ - 1) / 2 + 1) + (side_ - 1) / 2 + i],
-                m,
-                free,
-                face,
-                pos);
-            break;
-          }
-
-      if (auto it{block_mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 + 1) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 - 1 + i))};
-          it != std::end(block_mods_))
-        for (auto&& [block, pos] : it->second)
-          t[pos.x][pos.z][pos.y] = block;
-
-      terrains_[0][i] = std::move(terrains_[1][i]);
-      maps_[0][i] = std::move(maps_[1][i]);
-      free_lists_[0][i] = std::move(free_lists_[1][i]);
-
-      terrains_[1][i] = std::move(t);
-      maps_[1][i] = std::move(m);
-      free_lists_[i][0] = std::move(free);
-    }
-
+    for (auto i{0}; i < side_; ++i)
+      request_chunk({offset_.x + side_, offset_.y + i});
     ++offset_.x;
-    return true;
   }
   else if (position.x < offset_.x + side_ / 2) {
-    for (auto i{0}; i < side_; ++i) {
-      if (auto it{mods_.find(static_cast<uint64_t>(offset_.x - 1) << 32
-                             | static_cast<uint64_t>(offset_.y + i))};
-          it != std::end(mods_)) {
-        auto [f, m, t]{create_hot_chunk({offset_.x - 1, offset_.y + i})};
-        std::ranges::copy(f, staging_it);
-
-        Buffer b{nullptr,
-                 0,
-                 static_cast<int64_t>(std::size(f) * sizeof(Face)),
-                 static_cast<Face*>(staging_buffer.data)
-                     + (staging_it - std::begin(staging_view))};
-        Vector<unsigned> free;
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(b, m, free, block, face, pos);
-            break;
-          case Operation::destroy:
-            destroy_face(b, m, free, face, pos);
-            break;
-          }
-
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             b.size,
-             staging_buffer.data},
-            buffers_[(side_ - 1) * side_ + i]);
-        buffers_[(side_ - 1) * side_ + i].size = b.size;
-        staging_it += b.size / sizeof(Face);
-      }
-      else {
-        auto const f{create_chunk({offset_.x - 1, offset_.y + i})};
-        std::ranges::copy(f, staging_it);
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             gsl::narrow_cast<long long>(std::size(f) * sizeof(Face)),
-             staging_buffer.data},
-            buffers_[(side_ - 1) * side_ + i]);
-        buffers_[(side_ - 1) * side_ + i].size = std::size(f) * sizeof(Face);
-        staging_it += std::size(f);
-      }
-    }
-    for (auto i{side_ - 1}; i > 0; --i)
-      for (auto j{0}; j < side_; ++j)
-        std::swap(buffers_[i * side_ + j], buffers_[(i - 1) * side_ + j]);
-
-    for (auto i{0}; i < 2; ++i) {
-      auto [f, m, t]{create_hot_chunk(
-          {offset_.x + side_ / 2 - 2, offset_.y + side_ / 2 - 1 + i})};
-      std::ranges::copy(
-          f,
-          static_cast<Face*>(
-              buffers_[side_ * ((side_ - 1) / 2) + (side_ - 1) / 2 + i].data));
-      buffers_[side_ * ((side_ - 1) / 2) + (side_ - 1) / 2 + i].size =
-          std::size(f) * sizeof(Face);
-
-      Vector<unsigned> free;
-      if (auto it{mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 - 2) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 - 1 + i))};
-          it != std::end(mods_))
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(
-                buffers_[side_ * ((side_ - 1) / 2) + (side_ - 1) / 2 + i],
-                m,
-                free,
-                block,
-                face,
-                pos);
-            break;
-          case Operation::destroy:
-            destroy_face(
-                buffers_[side_ * ((side_ - 1) / 2) + (side_ - 1) / 2 + i],
-                m,
-                free,
-                face,
-                pos);
-            break;
-          }
-
-      if (auto it{block_mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 - 2) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 - 1 + i))};
-          it != std::end(block_mods_))
-        for (auto&& [block, pos] : it->second)
-          t[pos.x][pos.z][pos.y] = block;
-
-      terrains_[1][i] = std::move(terrains_[0][i]);
-      maps_[1][i] = std::move(maps_[0][i]);
-      free_lists_[1][i] = std::move(free_lists_[0][i]);
-
-      terrains_[0][i] = std::move(t);
-      maps_[0][i] = std::move(m);
-      free_lists_[i][0] = std::move(free);
-    }
-
+    for (auto i{0}; i < side_; ++i)
+      request_chunk({offset_.x - 1, offset_.y + i});
     --offset_.x;
-    return true;
   }
   else if (position.y > offset_.y + side_ / 2) {
-    for (auto i{0}; i < side_; ++i) {
-      if (auto it{mods_.find(static_cast<uint64_t>(offset_.x + i) << 32
-                             | static_cast<uint64_t>(offset_.y + side_))};
-          it != std::end(mods_)) {
-        auto [f, m, t]{create_hot_chunk({offset_.x + i, offset_.y + side_})};
-        std::ranges::copy(f, staging_it);
-
-        Buffer b{nullptr,
-                 0,
-                 static_cast<int64_t>(std::size(f) * sizeof(Face)),
-                 static_cast<Face*>(staging_buffer.data)
-                     + (staging_it - std::begin(staging_view))};
-        Vector<unsigned> free;
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(b, m, free, block, face, pos);
-            break;
-          case Operation::destroy:
-            destroy_face(b, m, free, face, pos);
-            break;
-          }
-
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             b.size,
-             staging_buffer.data},
-            buffers_[i * side_]);
-        buffers_[i * side_].size = b.size;
-        staging_it += b.size / sizeof(Face);
-      }
-      else {
-        auto const f{create_chunk({offset_.x + i, offset_.y + side_})};
-        std::ranges::copy(f, staging_it);
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             gsl::narrow_cast<long long>(std::size(f) * sizeof(Face)),
-             staging_buffer.data},
-            buffers_[i * side_]);
-        buffers_[i * side_].size = std::size(f) * sizeof(Face);
-        staging_it += std::size(f);
-      }
-    }
     for (auto i{0}; i < side_; ++i)
-      for (auto j{0}; j < side_ - 1; ++j)
-        std::swap(buffers_[i * side_ + j], buffers_[i * side_ + j + 1]);
-
-    for (auto i{0}; i < 2; ++i) {
-      auto [f, m, t]{create_hot_chunk(
-          {offset_.x + side_ / 2 - 1 + i, offset_.y + side_ / 2 + 1})};
-      std::ranges::copy(
-          f,
-          static_cast<Face*>(
-              buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + 1]
-                  .data));
-      buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + 1].size =
-          std::size(f) * sizeof(Face);
-
-      Vector<unsigned> free;
-      if (auto it{mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 - 1 + i) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 + 1))};
-          it != std::end(mods_))
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(
-                buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + 1],
-                m,
-                free,
-                block,
-                face,
-                pos);
-            break;
-          case Operation::destroy:
-            destroy_face(
-                buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + 1],
-                m,
-                free,
-                face,
-                pos);
-            break;
-          }
-
-      if (auto it{block_mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 - 1 + i) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 + 1))};
-          it != std::end(block_mods_))
-        for (auto&& [block, pos] : it->second)
-          t[pos.x][pos.z][pos.y] = block;
-
-      terrains_[i][0] = std::move(terrains_[i][1]);
-      maps_[i][0] = std::move(maps_[i][1]);
-      free_lists_[i][0] = std::move(free_lists_[i][1]);
-
-      terrains_[i][1] = std::move(t);
-      maps_[i][1] = std::move(m);
-      free_lists_[i][1] = std::move(free);
-    }
-
+      request_chunk({offset_.x + i, offset_.y + side_});
     ++offset_.y;
-    return true;
   }
   else if (position.y < offset_.y + side_ / 2) {
-    for (auto i{0}; i < side_; ++i) {
-      if (auto it{mods_.find(static_cast<uint64_t>(offset_.x + i) << 32
-                             | static_cast<uint64_t>(offset_.y - 1))};
-          it != std::end(mods_)) {
-        auto [f, m, t]{create_hot_chunk({offset_.x + i, offset_.y - 1})};
-        std::ranges::copy(f, staging_it);
-
-        Buffer b{nullptr,
-                 0,
-                 static_cast<int64_t>(std::size(f) * sizeof(Face)),
-                 static_cast<Face*>(staging_buffer.data)
-                     + (staging_it - std::begin(staging_view))};
-        Vector<unsigned> free;
-
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(b, m, free, block, face, pos);
-            break;
-          case Operation::destroy:
-            destroy_face(b, m, free, face, pos);
-            break;
-          }
-
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             b.size,
-             staging_buffer.data},
-            buffers_[i * side_ + side_ - 1]);
-        buffers_[i * side_ + side_ - 1].size = b.size;
-        staging_it += b.size / sizeof(Face);
-      }
-      else {
-        auto const f{create_chunk({offset_.x + i, offset_.y - 1})};
-        std::ranges::copy(f, staging_it);
-        copy_buffer(
-            command,
-            {staging_buffer.handle,
-             gsl::narrow_cast<long long>(
-                 staging_buffer.offset
-                 + (staging_it - std::begin(staging_view)) * sizeof(Face)),
-             gsl::narrow_cast<long long>(std::size(f) * sizeof(Face)),
-             staging_buffer.data},
-            buffers_[i * side_ + side_ - 1]);
-        buffers_[i * side_ + side_ - 1].size = std::size(f) * sizeof(Face);
-        staging_it += std::size(f);
-      }
-    }
     for (auto i{0}; i < side_; ++i)
-      for (auto j{side_ - 1}; j > 0; --j)
-        std::swap(buffers_[i * side_ + j], buffers_[i * side_ + j - 1]);
-
-    for (auto i{0}; i < 2; ++i) {
-      auto [f, m, t]{create_hot_chunk(
-          {offset_.x + side_ / 2 - 1 + i, offset_.y + side_ / 2 - 2})};
-      std::ranges::copy(
-          f,
-          static_cast<Face*>(
-              buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2].data));
-      buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2].size =
-          std::size(f) * sizeof(Face);
-
-      Vector<unsigned> free;
-      if (auto it{mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 - 1 + i) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 - 2))};
-          it != std::end(mods_))
-        for (auto&& [op, block, face, pos] : it->second)
-          switch (op) {
-          case Operation::place:
-            create_face(
-                buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2],
-                m,
-                free,
-                block,
-                face,
-                pos);
-            break;
-          case Operation::destroy:
-            destroy_face(
-                buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2],
-                m,
-                free,
-                face,
-                pos);
-            break;
-          }
-
-      if (auto it{block_mods_.find(
-              static_cast<uint64_t>(offset_.x + side_ / 2 - 1 + i) << 32
-              | static_cast<uint64_t>(offset_.y + side_ / 2 - 2))};
-          it != std::end(block_mods_))
-        for (auto&& [block, pos] : it->second)
-          t[pos.x][pos.z][pos.y] = block;
-
-      terrains_[i][1] = std::move(terrains_[i][0]);
-      maps_[i][1] = std::move(maps_[i][0]);
-      free_lists_[i][1] = std::move(free_lists_[i][0]);
-
-      terrains_[i][0] = std::move(t);
-      maps_[i][0] = std::move(m);
-      free_lists_[i][0] = std::move(free);
+      request_chunk({offset_.x + i, offset_.y - 1});
+    --offset_.y;
+  }
+  else
+    return false;
+
+  // the slots of the row that left the view now hold other chunks
+  for (auto it{std::begin(hot_chunks_)}; it != std::end(hot_chunks_);)
+    if (in_view(it->first))
+      ++it;
+    else
+      it = erase_hot_chunk(it);
+  return true;
+}
+
+void World::request_chunk(glm::ivec2 offset)
+{
+  auto const slot{get_slot(offset)};
+
+  // hide the stale mesh until the new one arrives
+  free_mesh(slot);
+  show(slot);
+  tickets_[slot] = next_ticket_++;
+
+  streamer_.request(
+      offset,
+      tickets_[slot],
+      [offset, mods = find_mods(offset), greedy = greedy_meshing_] {
+        // the staging buffer may still be read by the last upload, so the
+        // mesh goes to a buffer of its own, sized from the faces of the
+        // chunk as generated, merging only removes faces and an edited block
+        // changes at most the two faces on each of its sides
+        auto const generated{count_chunk_faces(offset)};
+        std::vector<Face> faces(
+            std::reduce(std::begin(generated), std::end(generated))
+            + 2 * 6 * std::ssize(mods));
+        auto const counts{create_cold_mesh(offset, mods, greedy, faces)};
+        auto const size{std::reduce(std::begin(counts), std::end(counts))};
+        if (size > std::ssize(faces))
+          throw std::runtime_error{"chunk mesh does not fit in its bound"};
+        faces.resize(size);
+        return std::pair{std::move(faces), counts};
+      });
+}
+
+bool World::upload(vk::CommandBuffer command, StagingRing& staging)
+{
+  streamer_.retain([this](glm::ivec2 offset) { return in_view(offset); });
+
+  // the graphics queue slides the meshes together first, and the copies
+  // wait until no frame reads where they moved from
+  if (defragment_pending_ || defragmented_ > frame_count_ - max_in_flight)
+    return false;
+
+  // a range is free once the frames that drew it are done, and those have
+  // been waited for on the host, so the copies need no barrier before them
+  auto recorded{false};
+  auto used{0ll};
+  auto const first_released{std::ssize(released_)};
+  // a mesh waits in the streamer while the ring is full
+  while (auto mesh{streamer_.poll(
+             std::min(chunk_upload_budget - used, staging.get_available()))}) {
+    if (!in_view(mesh->offset))
+      continue;
+    auto const slot{get_slot(mesh->offset)};
+    // the slot was reused or promoted to a hot chunk in the meantime
+    if (tickets_[slot] != mesh->ticket)
+      continue;
+    tickets_[slot] = 0;
+    if (!std::empty(mesh->error)) {
+      // the slot stays empty rather than asking for the same mesh forever
+      if (!std::exchange(stream_failed_, true))
+        std::cerr << "chunk mesh failed: " << mesh->error << '\n';
+      free_mesh(slot);
+      continue;
     }
 
-    --offset_.y;
-    return true;
+    auto const size{gsl::narrow_cast<long long>(std::size(mesh->faces)
+                                                * sizeof(Face))};
+    free_mesh(slot);
+    heights_[slot] = get_chunk_heights(mesh->offset);
+    if (size == 0)
+      continue;
+
+    auto const buffer{buffer_manager_.try_create(
+        chunk_buffer_usage, chunk_memory_, size)};
+    if (!buffer) {
+      // the next frame makes room, the mesh is made again meanwhile
+      defragment_pending_ = true;
+      request_chunk(mesh->offset);
+      break;
+    }
+    buffers_[slot] = *buffer;
+    pass_counts_[slot] = mesh->counts;
+
+    auto const range{*staging.allocate(size)};
+    std::ranges::copy(mesh->faces, static_cast<Face*>(range.data));
+    copy_buffer(command, range, buffers_[slot]);
+    if (g_context.has_transfer_family())
+      released_.push_back(buffers_[slot]);
+    used += size;
+    recorded = true;
   }
 
-  return false;
+  // hand the new meshes over to the graphics queue, update_meshes records
+  // the other half of each transfer
+  Vector<vk::BufferMemoryBarrier> barriers;
+  for (auto i{first_released}; i < std::ssize(released_); ++i) {
+    barriers.push_back(get_ownership_transfer(released_[i]));
+    barriers.back().srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+  }
+  if (!std::empty(barriers))
+    command.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eBottomOfPipe,
+                            {},
+                            {},
+                            barriers,
+                            {});
+  return recorded;
 }
 
-void World::place_block_help(int i,
-                             int j,
-                             BlockType block,
-                             FaceType face,
-                             glm::ivec3 pos)
+void World::update_meshes(vk::CommandBuffer command,
+                          StagingRing& staging,
+                          bool uploads_done)
 {
-  /*
-  if (block == BlockType::glass) {
-    create_face(i, j, block, FaceType::up, {pos.x, pos.y, pos.z});
-    create_face(i, j, block, FaceType::up, {pos.x, pos.y + 1, pos.z});
+  // the frame waits for the uploads at the vertex input, so the meshes they
+  // released are taken over there
+  Vector<vk::BufferMemoryBarrier> barriers;
+  for (auto&& buffer : released_) {
+    barriers.push_back(get_ownership_transfer(buffer));
+    barriers.back().dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead
+                                  | vk::AccessFlagBits::eShaderRead;
+  }
+  if (!std::empty(barriers))
+    command.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput
+                                | vk::PipelineStageFlagBits::eVertexShader,
+                            vk::PipelineStageFlagBits::eVertexInput
+                                | vk::PipelineStageFlagBits::eVertexShader,
+                            {},
+                            {},
+                            barriers,
+                            {});
+
+  // the frame waits for the uploads only at the vertex input, after the
+  // copies, so the block is moved once the host has seen the last upload
+  // finish, upload records no other while one is pending, and none of its
+  // meshes is still waiting to be taken over
+  if (defragment_pending_ && uploads_done && std::empty(released_)) {
+    defragment(command);
+    defragment_pending_ = false;
+    defragmented_ = frame_count_;
+  }
+  released_.clear();
+
+  // the faces edited since the last frame, a region per dirty range in a
+  // single copy, a chunk is sent whole or waits for the next frame while the
+  // frames draw the mesh held for it
+  auto const available{staging.get_available()};
+  auto edited{0ll};
+  Vector<std::pair<glm::ivec2, HotChunk*>> sent;
+  for (auto&& [offset, chunk] : hot_chunks_) {
+    chunk.unsent.clip(gsl::narrow_cast<unsigned>(std::size(chunk.mesh)));
+    auto size{0ll};
+    for (auto&& [first, last] : chunk.unsent)
+      size += (last - first) * sizeof(Face);
+    if (size != 0 && edited + size <= available) {
+      edited += size;
+      sent.push_back({offset, &chunk});
+    }
+  }
+  if (edited != 0)
+    send(command, staging.allocate(edited).value(), sent);
+
+  std::vector<bool> waiting(std::size(shown_));
+  for (auto&& [offset, chunk] : hot_chunks_)
+    waiting[get_slot(offset)] = !chunk.unsent.empty();
+  for (gsl::index slot{0}; slot < std::ssize(shown_); ++slot)
+    if (!waiting[slot])
+      show(slot);
+}
 
-    create_face(i, j, block, FaceType::down, {pos.x, pos.y, pos.z});
-    create_face(i, j, block, FaceType::down, {pos.x, pos.y - 1, pos.z});
+void World::send(vk::CommandBuffer command,
+                 Buffer const& range,
+                 std::span<std::pair<glm::ivec2, HotChunk*> const> chunks)
+{
+  auto const data{static_cast<Face*>(range.data)};
+  std::vector<vk::BufferCopy> regions;
+  auto copied{0ll};
+  for (auto&& [offset, chunk] : chunks) {
+    for (auto&& [first, last] : chunk->unsent) {
+      std::copy(std::begin(chunk->mesh) + first,
+                std::begin(chunk->mesh) + last,
+                data + copied);
+      regions.push_back(
+          {.srcOffset{gsl::narrow<unsigned long long>(
+               range.offset + copied * sizeof(Face))},
+           .dstOffset{gsl::narrow<unsigned long long>(
+               buffers_[get_slot(offset)].offset + first * sizeof(Face))},
+           .size{(last - first) * sizeof(Face)}});
+      copied += last - first;
+    }
+    chunk->unsent.clear();
+  }
 
-    create_face(i, j, block, FaceType::left, {pos.x, pos.y, pos.z});
-    create_face(i, j, block, FaceType::left, {pos.x + 1, pos.y, pos.z});
+  // the last frames may still draw the faces being replaced
+  command.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput
+                              | vk::PipelineStageFlagBits::eVertexShader,
+                          vk::PipelineStageFlagBits::eTransfer,
+                          {},
+                          {},
+                          {},
+                          {});
+  command.copyBuffer(range.handle, face_buffer_, regions);
+  command.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eVertexInput
+          | vk::PipelineStageFlagBits::eVertexShader,
+      {},
+      {{.srcAccessMask{vk::AccessFlagBits::eTransferWrite},
+        .dstAccessMask{vk::AccessFlagBits::eVertexAttributeRead
+                       | vk::AccessFlagBits::eShaderRead}}},
+      {},
+      {});
+}
 
-    create_face(i, j, block, FaceType::right, {pos.x, pos.y, pos.z});
-    create_face(i, j, block, FaceType::right, {pos.x - 1, pos.y, pos.z});
+vk::BufferMemoryBarrier World::get_ownership_transfer(Buffer const& buffer)
+{
+  return {.srcQueueFamilyIndex{
+              g_context.get_queue_family<QueueType::transfer>()},
+          .dstQueueFamilyIndex{
+              g_context.get_queue_family<QueueType::graphics>()},
+          .buffer{buffer.handle},
+          .offset{gsl::narrow<unsigned long long>(buffer.offset)},
+          .size{gsl::narrow<unsigned long long>(buffer.size)}};
+}
 
-    create_face(i, j, block, FaceType::front, {pos.x, pos.y, pos.z});
-    create_face(i, j, block, FaceType::front, {pos.x, pos.y, pos.z + 1});
+Buffer World::get_face_buffer() const noexcept
+{
+#if defined(CJCRAFT_VERTEX_PULLING)
+  return {face_buffer_, 0, get_chunk_block_size(), nullptr};
+#else
+  return {};
+#endif
+}
 
-    create_face(i, j, block, FaceType::back, {pos.x, pos.y, pos.z});
-    create_face(i, j, block, FaceType::back, {pos.x, pos.y, pos.z - 1});
-    return;
+long long World::count_faces() const noexcept
+{
+  return std::transform_reduce(std::begin(buffers_),
+                               std::end(buffers_),
+                               0ll,
+                               std::plus{},
+                               [](Buffer const& b) { return b.size; })
+       / gsl::narrow_cast<long long>(sizeof(Face));
+}
+
+BlockType World::get_block(glm::ivec3 pos)
+{
+  auto const [chunk, local]{locate(pos)};
+  if (!in_view(chunk) || local.y < 0 || local.y >= chunk_height)
+    return BlockType::air;
+  return get_hot_chunk(chunk).terrain.get(local);
+}
+
+HotChunk& World::get_hot_chunk(glm::ivec2 offset)
+{
+  auto const key{get_chunk_key(offset)};
+  if (auto const it{hot_index_.find(key)}; it != std::end(hot_index_)) {
+    hot_chunks_.splice(std::begin(hot_chunks_), hot_chunks_, it->second);
+    return it->second->second;
   }
-  */
 
-  // up
-  if (pos.y > 0)
-    if (block != BlockType::glass
-        && terrains_[i][j][pos.x][pos.z][pos.y - 1] != BlockType::air
-        && terrains_[i][j][pos.x][pos.z][pos.y - 1] != BlockType::glass)
-      destroy_face(i, j, FaceType::down, {pos.x, pos.y - 1, pos.z});
-    else
-      create_face(i, j, block, FaceType::up, {pos.x, pos.y, pos.z});
+  auto terrain{create_terrain(offset)};
+  for (auto&& [block, pos] : find_mods(offset))
+    terrain.set({pos.x, pos.y, pos.z}, block);
+  hot_chunks_.emplace_front(offset,
+                            HotChunk{std::move(terrain), {}, {}, false});
+  hot_index_[key] = std::begin(hot_chunks_);
+  return hot_chunks_.front().second;
+}
 
-  // down
-  if (block != BlockType::glass
-      && terrains_[i][j][pos.x][pos.z][pos.y + 1] != BlockType::air
-      && terrains_[i][j][pos.x][pos.z][pos.y - 1] != BlockType::glass)
-    destroy_face(i, j, FaceType::up, {pos.x, pos.y + 1, pos.z});
-  else
-    create_face(i, j, block, FaceType::down, {pos.x, pos.y, pos.z});
+void World::evict_hot_chunks()
+{
+  auto used{std::transform_reduce(
+      std::begin(hot_chunks_),
+      std::end(hot_chunks_),
+      0ll,
+      std::plus{},
+      [](auto const& chunk) { return get_memory_usage(chunk.second); })};
+  auto victim{std::end(hot_chunks_)};
+  while (used > hot_memory_cap_ && victim != std::begin(hot_chunks_)) {
+    auto& [offset, chunk]{*--victim};
+    // the mesh that stays behind still needs the last edits
+    if (chunk.dirty.any())
+      remesh(offset, chunk);
+    publish(offset, chunk);
+    if (!chunk.unsent.empty())
+      continue;
+    used -= get_memory_usage(chunk);
+    victim = erase_hot_chunk(victim);
+  }
+}
 
-  // right
-  if (auto b{pos.x + 1 != chunk_width ? terrains_[i][j][pos.x + 1][pos.z][pos.y]
-                                      : terrains_[i + 1][j][0][pos.z][pos.y]};
-      block == BlockType::glass || b == BlockType::air || b == BlockType::glass)
-    create_face(i, j, block, FaceType::right, {pos.x, pos.y, pos.z});
-  else
-    destroy_face(i, j, FaceType::left, {pos.x + 1, pos.y, pos.z});
+Vector<BlockMod> World::find_mods(glm::ivec2 offset) const
+{
+  Vector<BlockMod> mods;
+  // the chunk itself, then the first column and row of the chunks after,
+  // which are the border of this one
+  auto const add{[&](glm::ivec2 d) {
+    auto const it{block_mods_.find(get_chunk_key(offset + d))};
+    if (it == std::end(block_mods_))
+      return;
+    for (auto&& [key, block] : it->second) {
+      auto pos{static_cast<glm::u8vec3>(
+          glm::uvec3{key >> 16, key >> 8 & 0xff, key & 0xff})};
+      if ((d.x != 0 && pos.x != 0) || (d.y != 0 && pos.z != 0))
+        continue;
+      if (d.x != 0)
+        pos.x = chunk_width;
+      if (d.y != 0)
+        pos.z = chunk_depth;
+      mods.push_back({block, pos});
+    }
+  }};
+  add({0, 0});
+  add({1, 0});
+  add({0, 1});
+  add({1, 1});
+  return mods;
+}
 
-  // back
-  if (auto b{pos.z + 1 != chunk_depth ? terrains_[i][j][pos.x][pos.z + 1][pos.y]
-                                      : terrains_[i][j + 1][pos.x][0][pos.y]};
-      block == BlockType::glass || b == BlockType::air || b == BlockType::glass)
-    create_face(i, j, block, FaceType::back, {pos.x, pos.y, pos.z});
-  else
-    destroy_face(i, j, FaceType::front, {pos.x, pos.y, pos.z + 1});
-
-  // left
-  if (pos.x != 0)
-    if (block == BlockType::glass
-        || terrains_[i][j][pos.x - 1][pos.z][pos.y] == BlockType::air
-        || terrains_[i][j][pos.x - 1][pos.z][pos.y] == BlockType::glass)
-      create_face(i, j, block, FaceType::left, {pos.x, pos.y, pos.z});
-    else
-      destroy_face(i, j, FaceType::right, {pos.x - 1, pos.y, pos.z});
-  else if (block == BlockType::glass
-           || terrains_[i - 1][j][chunk_width - 1][pos.z][pos.y]
-                  == BlockType::air
-           || terrains_[i - 1][j][chunk_width - 1][pos.z][pos.y]
-                  == BlockType::glass)
-    create_face(i - 1, j, block, FaceType::left, {chunk_width, pos.y, pos.z});
-  else
-    destroy_face(i - 1, j, FaceType::right, {chunk_width - 1, pos.y, pos.z});
-
-  // front
-  if (pos.z != 0)
-    if (block == BlockType::glass
-        || terrains_[i][j][pos.x][pos.z - 1][pos.y] == BlockType::air
-        || terrains_[i][j][pos.x][pos.z - 1][pos.y] == BlockType::glass)
-      create_face(i, j, block, FaceType::front, {pos.x, pos.y, pos.z});
-    else
-      destroy_face(i, j, FaceType::back, {pos.x, pos.y, pos.z - 1});
-  else if (block == BlockType::glass
-           || terrains_[i][j - 1][pos.x][chunk_depth - 1][pos.y]
-                  == BlockType::air
-           || terrains_[i][j - 1][pos.x][chunk_depth - 1][pos.y]
-                  == BlockType::glass)
-    create_face(i, j - 1, block, FaceType::front, {pos.x, pos.y, chunk_depth});
-  else
-    destroy_face(i, j - 1, FaceType::back, {pos.x, pos.y, chunk_depth - 1});
+std::pair<int, int> World::get_chunk_heights(glm::ivec2 offset) const
+{
+  if (!std::empty(find_mods(offset)))
+    return full_height_range;
+  return get_height_range(offset);
 }
 
-void World::destroy_block_help(int i, int j, FaceType face, glm::ivec3 pos)
+PassCounts World::create_cold_mesh(glm::ivec2 offset,
+                                   std::span<BlockMod const> mods,
+                                   bool greedy,
+                                   std::span<Face> faces)
 {
-  // destory up
-  if (pos.y > 0)
-    if (terrains_[i][j][pos.x][pos.z][pos.y - 1] == BlockType::air)
-      destroy_face(i, j, FaceType::up, {pos.x, pos.y, pos.z});
-    else
-      create_face(i,
-                  j,
-                  terrains_[i][j][pos.x][pos.z][pos.y - 1],
-                  FaceType::down,
-                  {pos.x, pos.y - 1, pos.z});
-
-  // destroy down
-  if (terrains_[i][j][pos.x][pos.z][pos.y + 1] == BlockType::air)
-    destroy_face(i, j, FaceType::down, {pos.x, pos.y, pos.z});
-  else
-    create_face(i,
-                j,
-                terrains_[i][j][pos.x][pos.z][pos.y + 1],
-                FaceType::up,
-                {pos.x, pos.y + 1, pos.z});
-
-  // destroy right
-  if (auto b{pos.x + 1 != chunk_width ? terrains_[i][j][pos.x + 1][pos.z][pos.y]
-                                      : terrains_[i + 1][j][0][pos.z][pos.y]};
-      b == BlockType::air)
-    destroy_face(i, j, FaceType::right, {pos.x, pos.y, pos.z});
-  else
-    create_face(i, j, b, FaceType::left, {pos.x + 1, pos.y, pos.z});
+#if !defined(CJCRAFT_VERTEX_PULLING)
+  if (std::empty(mods) && greedy)
+    return create_greedy_chunk(offset, faces);
+#endif
+  if (std::empty(mods))
+    return create_chunk(offset, faces);
+
+  // an edited chunk is meshed from its blocks rather than its height map
+  auto terrain{create_terrain(offset)};
+  for (auto&& [block, pos] : mods)
+    terrain.set({pos.x, pos.y, pos.z}, block);
+  return create_terrain_mesh(terrain, greedy, faces);
+}
 
-  // destroy back
-  if (auto b{pos.z + 1 != chunk_depth ? terrains_[i][j][pos.x][pos.z + 1][pos.y]
-                                      : terrains_[i][j + 1][pos.x][0][pos.y]};
-      b == BlockType::air)
-    destroy_face(i, j, FaceType::back, {pos.x, pos.y, pos.z});
-  else
-    create_face(i, j, b, FaceType::front, {pos.x, pos.y, pos.z + 1});
+void World::set_block(glm::ivec2 chunk, glm::ivec3 pos, BlockType block)
+{
+  // only the net change of each block is kept, so replaying the log costs
+  // the number of blocks that differ rather than the edits made
+  auto const key{get_chunk_key(chunk)};
+  if (block != get_generated_block(chunk, pos))
+    block_mods_[key][get_block_key(pos)] = block;
+  else if (auto const it{block_mods_.find(key)}; it != std::end(block_mods_)) {
+    it->second.erase(get_block_key(pos));
+    if (std::empty(it->second))
+      block_mods_.erase(it);
+  }
 
-  // destroy left
-  if (pos.x != 0)
-    if (terrains_[i][j][pos.x - 1][pos.z][pos.y] == BlockType::air)
-      destroy_face(i, j, FaceType::left, {pos.x, pos.y, pos.z});
-    else
-      create_face(i,
-                  j,
-                  terrains_[i][j][pos.x - 1][pos.z][pos.y],
-                  FaceType::right,
-                  {pos.x - 1, pos.y, pos.z});
-  else if (terrains_[i - 1][j][chunk_width - 1][pos.z][pos.y] == BlockType::air)
-    destroy_face(i - 1, j, FaceType::left, {chunk_width, pos.y, pos.z});
-  else
-    create_face(i - 1,
-                j,
-                terrains_[i - 1][j][chunk_width - 1][pos.z][pos.y],
-                FaceType::right,
-                {chunk_width - 1, pos.y, pos.z});
-
-  // destroy front
-  if (pos.z != 0)
-    if (terrains_[i][j][pos.x][pos.z - 1][pos.y] == BlockType::air)
-      destroy_face(i, j, FaceType::front, {pos.x, pos.y, pos.z});
-    else
-      create_face(i,
-                  j,
-                  terrains_[i][j][pos.x][pos.z - 1][pos.y],
-                  FaceType::back,
-                  {pos.x, pos.y, pos.z - 1});
-  else if (terrains_[i][j - 1][pos.x][chunk_depth - 1][pos.y] == BlockType::air)
-    destroy_face(i, j - 1, FaceType::front, {pos.x, pos.y, chunk_depth});
-  else
-    create_face(i,
-                j - 1,
-                terrains_[i][j - 1][pos.x][chunk_depth - 1][pos.y],
-                FaceType::back,
-                {pos.x, pos.y, chunk_depth - 1});
-}
-
-void World::create_face(int i,
-                        int j,
-                        BlockType block,
-                        FaceType face,
-                        glm::ivec3 pos)
-{
-  mods_[static_cast<uint64_t>(offset_.x + (side_ - 1) / 2 + i) << 32
-        | static_cast<uint64_t>(offset_.y + (side_ - 1) / 2 + j)]
-      .push_back(
-          {Operation::place, block, face, static_cast<glm::u8vec3>(pos)});
-
-  auto ptr{static_cast<Face*>(
-      buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j].data)};
-  if (free_lists_[i][j].empty()) {
-    ptr[buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j].size
-        / sizeof(Face)] = get_vertices(block, face, pos);
-    maps_[i][j][pack_face_key(face, pos)] =
-        buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j].size
-        / sizeof(Face);
-    buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j].size +=
-        sizeof(Face);
+  // a block changes the faces of the layers next to it as well
+  auto const mark{[&](HotChunk& hot) {
+    for (auto y{std::max(0, pos.y - 1)};
+         y < std::min(chunk_height, pos.y + 2);
+         ++y)
+      hot.dirty.set(y / section_height);
+  }};
+  auto& hot{get_hot_chunk(chunk)};
+  hot.terrain.set(pos, block);
+  mark(hot);
+
+  // the chunks before own the faces between them and this chunk
+  if (pos.x == 0) {
+    auto& left{get_hot_chunk(chunk - glm::ivec2{1, 0})};
+    left.terrain.set({chunk_width, pos.y, pos.z}, block);
+    mark(left);
   }
-  else {
-    ptr[free_lists_[i][j].back()] = get_vertices(block, face, pos);
-    maps_[i][j][pack_face_key(face, pos)] = free_lists_[i][j].back();
-    free_lists_[i][j].pop_back();
+  if (pos.z == 0) {
+    auto& front{get_hot_chunk(chunk - glm::ivec2{0, 1})};
+    front.terrain.set({pos.x, pos.y, chunk_depth}, block);
+    mark(front);
+  }
+  // the corner has no faces there, a chunk that is not hot picks the block
+  // up from the log
+  if (auto const it{hot_index_.find(get_chunk_key(chunk - glm::ivec2{1, 1}))};
+      pos.x == 0 && pos.z == 0 && it != std::end(hot_index_))
+    it->second->second.terrain.set({chunk_width, pos.y, chunk_depth}, block);
+}
+
+void World::remesh()
+{
+  for (auto&& [offset, chunk] : hot_chunks_)
+    if (chunk.dirty.any())
+      remesh(offset, chunk);
+
+  // compact the mesh with the most holes, one per frame keeps the cost of
+  // moving faces off the edit path
+  auto worst{std::end(hot_chunks_)};
+  auto worst_ratio{max_hole_ratio};
+  for (auto it{std::begin(hot_chunks_)}; it != std::end(hot_chunks_); ++it)
+    if (auto const size{pass_counts_[get_slot(it->first)][0]};
+        it->second.sectioned && size != 0) {
+      auto const ratio{static_cast<double>(count_holes(it->first, it->second))
+                       / size};
+      if (ratio > worst_ratio) {
+        worst = it;
+        worst_ratio = ratio;
+      }
+    }
+  if (worst != std::end(hot_chunks_)) {
+    auto& [offset, chunk]{*worst};
+    hold(get_slot(offset));
+    chunk.mesh.resize(pass_counts_[get_slot(offset)][0]);
+    compaction_stats_.holes_reclaimed += compact(offset, chunk);
+    ++compaction_stats_.compactions;
+    lay_out_later(offset, chunk, false);
   }
+
+  for (auto&& [offset, chunk] : hot_chunks_)
+    publish(offset, chunk);
 }
 
-void World::create_face(Buffer& buffer,
-                        HashMap<unsigned, unsigned>& map,
-                        Vector<unsigned>& free,
-                        BlockType block,
-                        FaceType face,
-                        glm::ivec3 pos)
+void World::remesh(glm::ivec2 offset, HotChunk& chunk)
 {
-  auto ptr{static_cast<Face*>(buffer.data)};
-  if (free.empty()) {
-    ptr[buffer.size / sizeof(Face)] = get_vertices(block, face, pos);
-    map[pack_face_key(face, pos)] = buffer.size / sizeof(Face);
-    buffer.size += sizeof(Face);
+  hold(get_slot(offset));
+  if (!chunk.sectioned) {
+    lay_out_sections(offset, chunk);
+    chunk.dirty.reset();
+    return;
+  }
+
+  // the cutout and water faces come off the end and are laid out again once
+  // the opaque sections are done
+  auto& mesh{chunk.mesh};
+  mesh.resize(pass_counts_[get_slot(offset)][0]);
+  auto later_changed{false};
+  std::array<std::vector<Face>, nb_mesh_passes> section;
+  for (auto s{0}; s < nb_sections; ++s) {
+    if (!chunk.dirty[s])
+      continue;
+    for (auto&& faces : section)
+      faces.clear();
+    append_section_mesh(chunk.terrain, s, section);
+    for (auto p{1}; p < nb_mesh_passes; ++p) {
+      auto& later{chunk.later[p - 1][s]};
+      later_changed = later_changed || !std::empty(later)
+                   || !std::empty(section[p]);
+      std::swap(later, section[p]);
+    }
+
+    auto const& faces{section[0]};
+    auto const count{gsl::narrow_cast<unsigned>(std::size(faces))};
+    auto const room{chunk.capacity - count_later_faces(chunk)};
+    auto& range{chunk.sections[s]};
+    if (count > range.capacity) {
+      // the section at the end of the mesh grows in place, any other one
+      // leaves its slots as holes and moves to the end
+      std::fill_n(std::begin(mesh) + range.first, range.count, Face{});
+      chunk.unsent.add(range.first, range.first + range.count);
+      if (auto const end{gsl::narrow_cast<unsigned>(std::size(mesh))};
+          range.first + range.capacity != end)
+        range = {end, 0, 0};
+      if (range.first + count > room) {
+        // the old faces of the section are gone, so it takes no room while
+        // the others move down
+        range = {range.first, 0, 0};
+        compaction_stats_.holes_reclaimed += compact(offset, chunk);
+        ++compaction_stats_.compactions;
+        range = {gsl::narrow_cast<unsigned>(std::size(mesh)), 0, 0};
+      }
+      if (range.first + count > room) {
+        // the chunk outgrew its range, it is laid out again in a larger one
+        lay_out_sections(offset, chunk);
+        chunk.dirty.reset();
+        return;
+      }
+      range.capacity = count;
+      mesh.resize(range.first + count);
+    }
+    std::ranges::copy(faces, std::begin(mesh) + range.first);
+    if (count < range.count)
+      std::fill(std::begin(mesh) + range.first + count,
+                std::begin(mesh) + range.first + range.count,
+                Face{});
+    chunk.unsent.add(range.first, range.first + std::max(count, range.count));
+    range.count = count;
+  }
+  chunk.dirty.reset();
+  if (std::ssize(mesh) + count_later_faces(chunk) > chunk.capacity) {
+    lay_out_sections(offset, chunk);
+    return;
+  }
+  lay_out_later(offset, chunk, later_changed);
+}
+
+void World::lay_out_sections(glm::ivec2 offset, HotChunk& chunk)
+{
+  auto& faces{chunk.mesh};
+  faces.clear();
+  std::array<std::vector<Face>, nb_mesh_passes> section;
+  for (auto s{0}; s < nb_sections; ++s) {
+    for (auto&& i : section)
+      i.clear();
+    append_section_mesh(chunk.terrain, s, section);
+    auto const first{gsl::narrow_cast<unsigned>(std::size(faces))};
+    auto const count{gsl::narrow_cast<unsigned>(std::size(section[0]))};
+    faces.insert(std::end(faces), std::begin(section[0]), std::end(section[0]));
+    chunk.sections[s] = {first, count, count};
+    for (auto p{1}; p < nb_mesh_passes; ++p)
+      std::swap(chunk.later[p - 1][s], section[p]);
+  }
+
+  // a hot mesh gets the full size so its sections can grow in place, twice
+  // as much as it had if its faces do not fit, and the earlier versions go
+  // as they are smaller
+  auto const slot{get_slot(offset)};
+  free_mesh(slot);
+  for (auto&& version : chunk.versions)
+    retire(version.buffer);
+  chunk.versions.clear();
+  chunk.capacity = std::max(chunk.capacity, max_chunk_faces);
+  while (std::ssize(faces) + count_later_faces(chunk) > chunk.capacity)
+    chunk.capacity *= 2;
+  auto const buffer{buffer_manager_.try_create(
+      chunk_buffer_usage,
+      chunk_memory_,
+      chunk.capacity * gsl::narrow_cast<long long>(sizeof(Face)))};
+  if (!buffer)
+    throw std::runtime_error{"chunk meshes do not fit in their block"};
+  buffers_[slot] = *buffer;
+  lay_out_later(offset, chunk, true);
+  // no frame draws the new range yet
+  chunk.unsent.clear();
+  if (buffers_[slot].data)
+    std::ranges::copy(faces, static_cast<Face*>(buffers_[slot].data));
+  else
+    chunk.unsent.add(0, gsl::narrow_cast<unsigned>(std::size(faces)));
+  // a mesh still being streamed for the slot is stale now
+  tickets_[slot] = 0;
+  heights_[slot] = full_height_range;
+  chunk.sectioned = true;
+}
+
+void World::free_mesh(gsl::index slot)
+{
+  // a held range is retired once the frames stop drawing it
+  if (!shown_[slot] || !same_range(shown_[slot]->first, buffers_[slot]))
+    retire(buffers_[slot]);
+  buffers_[slot] = {};
+  pass_counts_[slot] = {};
+}
+
+void World::hold(gsl::index slot)
+{
+  if (!(chunk_memory_ & vk::MemoryPropertyFlagBits::eHostVisible)
+      && !shown_[slot])
+    shown_[slot] = {buffers_[slot], pass_counts_[slot]};
+}
+
+void World::show(gsl::index slot)
+{
+  if (!shown_[slot])
+    return;
+  if (!same_range(shown_[slot]->first, buffers_[slot]))
+    retire(shown_[slot]->first);
+  shown_[slot].reset();
+}
+
+void World::retire(Buffer const& buffer)
+{
+  if (buffer.handle)
+    retired_.push_back({buffer, frame_count_ - 1});
+}
+
+void World::publish(glm::ivec2 offset, HotChunk& chunk)
+{
+  auto& current{buffers_[get_slot(offset)]};
+  if (!current.data || chunk.unsent.empty())
+    return;
+
+  // the frames in flight draw the current mesh, so the edits go to a version
+  // none of them draws, which only misses the faces edited since it was
+  // current
+  auto const size{gsl::narrow_cast<unsigned>(std::size(chunk.mesh))};
+  MeshVersion next;
+  if (auto const it{std::ranges::find_if(
+          chunk.versions,
+          [&](MeshVersion const& v) {
+            return v.frame <= frame_count_ - max_in_flight;
+          })};
+      it != std::end(chunk.versions)) {
+    next = std::move(*it);
+    chunk.versions.erase(it);
   }
   else {
-    ptr[free.back()] = get_vertices(block, face, pos);
-    map[pack_face_key(face, pos)] = free.back();
-    free.pop_back();
+    auto const buffer{buffer_manager_.try_create(
+        chunk_buffer_usage,
+        chunk_memory_,
+        chunk.capacity * gsl::narrow_cast<long long>(sizeof(Face)))};
+    if (!buffer)
+      throw std::runtime_error{"chunk meshes do not fit in their block"};
+    next.buffer = *buffer;
+    next.stale.add(0, size);
+  }
+  for (auto&& [first, last] : chunk.unsent) {
+    next.stale.add(first, last);
+    for (auto&& version : chunk.versions)
+      version.stale.add(first, last);
   }
+  next.stale.clip(size);
+  for (auto&& [first, last] : next.stale)
+    std::copy(std::begin(chunk.mesh) + first,
+              std::begin(chunk.mesh) + last,
+              static_cast<Face*>(next.buffer.data) + first);
+
+  chunk.versions.push_back(
+      {current, frame_count_ - 1, std::move(chunk.unsent)});
+  chunk.unsent.clear();
+  current = next.buffer;
+  current.size = size * sizeof(Face);
 }
 
-void World::destroy_face(int i, int j, FaceType face, glm::ivec3 pos)
+std::list<std::pair<glm::ivec2, HotChunk>>::iterator
+World::erase_hot_chunk(std::list<std::pair<glm::ivec2, HotChunk>>::iterator it)
 {
-  mods_[static_cast<uint64_t>(offset_.x + (side_ - 1) / 2 + i) << 32
-        | static_cast<uint64_t>(offset_.y + (side_ - 1) / 2 + j)]
-      .push_back({Operation::destroy, {}, face, static_cast<glm::u8vec3>(pos)});
+  for (auto&& version : it->second.versions)
+    retire(version.buffer);
+  hot_index_.erase(get_chunk_key(it->first));
+  return hot_chunks_.erase(it);
+}
+
+void World::defragment(vk::CommandBuffer command)
+{
+  // hot meshes are written from the host, a copy would land over them, and
+  // the versions and retired ranges are not the mesh of any slot
+  HashMap<long long, gsl::index> slots;
+  for (gsl::index slot{0}; slot < std::ssize(buffers_); ++slot)
+    if (buffers_[slot].handle && !shown_[slot])
+      slots[buffers_[slot].offset] = slot;
+  for (auto&& [offset, chunk] : hot_chunks_)
+    if (chunk.sectioned)
+      slots.erase(buffers_[get_slot(offset)].offset);
+
+  for (auto&& [from, to] : buffer_manager_.defragment(
+           command, chunk_buffer_usage, chunk_memory_, [&](Buffer const& b) {
+             return slots.contains(b.offset);
+           })) {
+    auto& buffer{buffers_[slots.at(from.offset)]};
+    buffer.offset = to.offset;
+    buffer.data = to.data;
+  }
+}
 
-  auto it{maps_[i][j].find(pack_face_key(face, pos))};
-  auto ptr{static_cast<Face*>(
-      buffers_[side_ * ((side_ - 1) / 2 + i) + (side_ - 1) / 2 + j].data)};
-  ptr[it->second] = {};
-  free_lists_[i][j].push_back(it->second);
-  maps_[i][j].erase(it);
+long long World::count_holes(glm::ivec2 offset, HotChunk const& chunk) const
+{
+  return pass_counts_[get_slot(offset)][0]
+       - std::transform_reduce(std::begin(chunk.sections),
+                               std::end(chunk.sections),
+                               0ll,
+                               std::plus{},
+                               [](SectionRange const& r) { return r.count; });
 }
 
-void World::destroy_face(Buffer& buffer,
-                         HashMap<unsigned, unsigned>& map,
-                         Vector<unsigned>& free,
-                         FaceType face,
-                         glm::ivec3 pos)
+long long World::compact(glm::ivec2 offset, HotChunk& chunk)
 {
-  if (auto it{map.find(pack_face_key(face, pos))}; it != std::end(map)) {
-    auto ptr{static_cast<Face*>(buffer.data)};
-    ptr[it->second] = {};
-    free.push_back(it->second);
-    map.erase(it);
+  auto const data{std::data(chunk.mesh)};
+
+  // every section moves down, so going in mesh order never overwrites a
+  // face that has yet to move
+  std::array<int, nb_sections> order;
+  std::iota(std::begin(order), std::end(order), 0);
+  std::ranges::sort(
+      order, {}, [&](int s) { return chunk.sections[s].first; });
+  auto end{0u};
+  for (auto s : order) {
+    auto& range{chunk.sections[s]};
+    if (range.first != end)
+      std::copy_n(data + range.first, range.count, data + end);
+    range = {end, range.count, range.count};
+    end += range.count;
   }
+
+  auto const reclaimed{
+      gsl::narrow_cast<long long>(std::size(chunk.mesh) - end)};
+  chunk.mesh.resize(end);
+  chunk.unsent.add(0, end);
+  return reclaimed;
+}
+
+void World::lay_out_later(glm::ivec2 offset, HotChunk& chunk, bool changed)
+{
+  auto& mesh{chunk.mesh};
+  auto const slot{get_slot(offset)};
+  auto const end{gsl::narrow_cast<unsigned>(std::size(mesh))};
+  auto& counts{pass_counts_[slot]};
+  changed = changed || counts[0] != end;
+  counts = {end};
+  for (auto p{1}; p < nb_mesh_passes; ++p)
+    for (auto&& faces : chunk.later[p - 1]) {
+      mesh.insert(std::end(mesh), std::begin(faces), std::end(faces));
+      counts[p] += std::ssize(faces);
+    }
+
+  buffers_[slot].size = std::size(mesh) * sizeof(Face);
+  if (changed)
+    chunk.unsent.add(end, gsl::narrow_cast<unsigned>(std::size(mesh)));
 }
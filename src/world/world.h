@@ -1,127 +1,117 @@
 #pragma once
 
 #include "chunk.h"
+#include "dirty_ranges.h"
 #include "control/camera.h"
 #include "memory/buffer_manager.h"
+#include "memory/staging_ring.h"
+#include "stream.h"
 
 #include <array>
+#include <bitset>
 #include <cstdint>
+#include <list>
+#include <optional>
 #include <span>
 #include <vector>
 
-enum struct Operation : unsigned char {
-  place,
-  destroy
-};
+// the faces of 300'000 bytes of six vertex quads, pulled faces are smaller
+// but a chunk gets as many of them, a hot mesh starts with that room and
+// doubles it when it runs out
+inline constexpr long long max_chunk_faces{
+    300'000 / (Face::nb_vertices * sizeof(Vertex))};
+inline constexpr auto chunk_buffer_size{
+    max_chunk_faces * gsl::narrow_cast<long long>(sizeof(Face))};
+// bytes of streamed meshes uploaded per transfer submission
+inline constexpr auto chunk_upload_budget{1ll << 23};
+// edited chunks may have blocks anywhere
+inline constexpr std::pair<int, int> full_height_range{0, chunk_height};
 
-struct alignas(8) FaceMod {
-  Operation op;
+struct BlockMod {
   BlockType block;
-  FaceType face;
   glm::u8vec3 pos;
 };
 
-struct BlockMod {
-  BlockType block;
-  glm::u8vec3 pos;
+// where the faces of a section sit in the mesh of its chunk, the slots from
+// count up to capacity are holes
+struct SectionRange {
+  unsigned first;
+  unsigned count;
+  unsigned capacity;
+};
+
+// an earlier mesh of a hot chunk in a host visible chunk buffer
+struct MeshVersion {
+  Buffer buffer;
+  // the last frame that may have drawn it
+  long long frame;
+  // the faces edited since it was the current mesh
+  DirtyRanges stale;
+};
+
+// the voxels of a chunk that is queried or edited, once edited its mesh is
+// laid out section by section so an edit only rebuilds the sections it touches
+struct HotChunk {
+  Terrain terrain;
+  std::array<SectionRange, nb_sections> sections;
+  // rebuilt by the next remesh
+  std::bitset<nb_sections> dirty;
+  // the slot keeps the cold mesh of the chunk until its first edit, the
+  // sections are laid out then
+  bool sectioned;
+  // the faces of the laid out mesh, the chunk buffer holds a copy, the
+  // sections only hold the opaque faces and the cutout and water faces of
+  // all of them follow, pass by pass
+  std::vector<Face> mesh;
+  // the faces the chunk buffer and its versions have room for
+  long long capacity;
+  // the cutout and water faces of each section
+  std::array<std::array<std::vector<Face>, nb_sections>, nb_mesh_passes - 1>
+      later;
+  // the faces of mesh the chunk buffer is still waiting for
+  DirtyRanges unsent;
+  // the meshes the frames in flight may still draw, an edit goes to one of
+  // those they are done with
+  Vector<MeshVersion> versions;
 };
 
 class World {
 public:
-  World(vk::CommandBuffer command, Buffer staging_buffer, int render_distance);
+  // hot meshes are written straight into the chunk buffers if
+  // direct_chunk_writes is set and the device has host visible device local
+  // memory that the chunk block fits in, they go through the staging ring
+  // otherwise
+  World(int render_distance,
+        bool greedy_meshing,
+        long long hot_memory_cap,
+        bool direct_chunk_writes);
 
   std::tuple<bool, bool, bool, bool> hit_wall(Camera& camera)
   {
-    auto pos{glm::ivec3{gsl::narrow_cast<int>(camera.pos_.x),
-                        gsl::narrow_cast<int>(camera.pos_.y),
-                        gsl::narrow_cast<int>(camera.pos_.z)}};
-    auto hot_chunk_i{0};
-    if (pos.x >= offset_.x * chunk_width + chunk_width * (side_ / 2)) {
-      hot_chunk_i = 1;
-      pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2);
-    }
-    else
-      pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2 - 1);
-    auto hot_chunk_j{0};
-    if (pos.z >= offset_.y * chunk_depth + chunk_depth * (side_ / 2)) {
-      hot_chunk_j = 1;
-      pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2);
-    }
-    else
-      pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2 - 1);
-
-    auto b1{false};
-    auto b2{false};
-    auto b3{false};
-    auto b4{false};
-    if (terrains_[hot_chunk_i][hot_chunk_j][pos.x + 1][pos.z][pos.y]
-            == BlockType::air
-        && terrains_[hot_chunk_i][hot_chunk_j][pos.x + 1][pos.z][pos.y + 1]
-               == BlockType::air)
-      b1 = true;
-    if (terrains_[hot_chunk_i][hot_chunk_j][pos.x][pos.z + 1][pos.y]
-            == BlockType::air
-        && terrains_[hot_chunk_i][hot_chunk_j][pos.x][pos.z + 1][pos.y + 1]
-               == BlockType::air)
-      b2 = true;
-    if (pos.x != 0) {
-      if (terrains_[hot_chunk_i][hot_chunk_j][pos.x - 1][pos.z][pos.y]
-              == BlockType::air
-          && terrains_[hot_chunk_i][hot_chunk_j][pos.x - 1][pos.z][pos.y + 1]
-                 == BlockType::air)
-        b3 = true;
-    }
-    else if (terrains_[hot_chunk_i - 1][hot_chunk_j][chunk_width - 1][pos.z]
-                      [pos.y]
-                 == BlockType::air
-             && terrains_[hot_chunk_i - 1][hot_chunk_j][chunk_width - 1][pos.z]
-                         [pos.y + 1]
-                    == BlockType::air)
-      b3 = true;
-    if (pos.z != 0) {
-      if (terrains_[hot_chunk_i][hot_chunk_j][pos.x][pos.z - 1][pos.y]
-              == BlockType::air
-          && terrains_[hot_chunk_i][hot_chunk_j][pos.x][pos.z - 1][pos.y + 1]
-                 == BlockType::air)
-        b4 = true;
-    }
-    else if (terrains_[hot_chunk_i][hot_chunk_j - 1][pos.x][chunk_depth - 1]
-                      [pos.y]
-                 == BlockType::air
-             && terrains_[hot_chunk_i][hot_chunk_j - 1][pos.x][chunk_depth - 1]
-                         [pos.y + 1]
-                    == BlockType::air)
-      b4 = true;
-    return {b1, b2, b3, b4};
+    evict_hot_chunks();
+    auto const pos{glm::ivec3{gsl::narrow_cast<int>(camera.pos_.x),
+                              gsl::narrow_cast<int>(camera.pos_.y),
+                              gsl::narrow_cast<int>(camera.pos_.z)}};
+    auto const is_open{[this](glm::ivec3 p) {
+      return get_block(p) == BlockType::air
+          && get_block({p.x, p.y + 1, p.z}) == BlockType::air;
+    }};
+    return {is_open({pos.x + 1, pos.y, pos.z}),
+            is_open({pos.x, pos.y, pos.z + 1}),
+            is_open({pos.x - 1, pos.y, pos.z}),
+            is_open({pos.x, pos.y, pos.z - 1})};
   }
 
   bool fix_camera(Camera& camera)
   {
+    evict_hot_chunks();
     auto pos{glm::ivec3{gsl::narrow_cast<int>(camera.pos_.x),
                         gsl::narrow_cast<int>(camera.pos_.y + 1.75),
                         gsl::narrow_cast<int>(camera.pos_.z)}};
-    auto hot_chunk_i{0};
-    if (pos.x >= offset_.x * chunk_width + chunk_width * (side_ / 2)) {
-      hot_chunk_i = 1;
-      pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2);
-    }
-    else
-      pos.x -= offset_.x * chunk_width + chunk_width * (side_ / 2 - 1);
-    auto hot_chunk_j{0};
-    if (pos.z >= offset_.y * chunk_depth + chunk_depth * (side_ / 2)) {
-      hot_chunk_j = 1;
-      pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2);
-    }
-    else
-      pos.z -= offset_.y * chunk_depth + chunk_depth * (side_ / 2 - 1);
-
-    if (terrains_[hot_chunk_i][hot_chunk_j][pos.x][pos.z][pos.y]
-        == BlockType::air)
+    if (get_block(pos) == BlockType::air)
       return false;
-    while (terrains_[hot_chunk_i][hot_chunk_j][pos.x][pos.z][pos.y]
-           != BlockType::air) {
+    while (get_block(pos) != BlockType::air)
       --pos.y;
-    }
     camera.pos_.y = gsl::narrow_cast<float>(pos.y) - 0.75;
     return true;
   }
@@ -130,50 +120,246 @@ public:
 
   bool destroy_block(FaceType face, glm::ivec3 pos);
 
+  // rebuild the sections edited since the last call, once per frame
+  void remesh();
+
   // update
-  bool
-  move(vk::CommandBuffer command, Buffer staging_buffer, glm::ivec2 position);
+  bool move(glm::ivec2 position);
 
-  void draw(vk::CommandBuffer command,
+  // record the copies of the streamed meshes that fit in staging for the
+  // transfer queue, returns whether any was recorded, the caller submits
+  // them to staging and the next frame waits for them at the vertex input
+  bool upload(vk::CommandBuffer command, StagingRing& staging);
+
+  // record what the frame needs before cull on the graphics queue: take over
+  // the meshes of the last upload, make room for those that did not fit once
+  // uploads_done tells that the device has finished every upload submitted,
+  // and copy the faces edited since the last frame
+  void update_meshes(vk::CommandBuffer command,
+                     StagingRing& staging,
+                     bool uploads_done);
+
+  // fill the chunk infos of this frame and record the culling pass, the cull
+  // pipeline and its descriptor set have to be bound already, the water of
+  // the chunks is drawn from the farthest to eye to the nearest
+  void cull(vk::CommandBuffer command,
+            gsl::index frame,
             vk::PipelineLayout layout,
-            glm::vec2 pos,
-            glm::vec2 front) const;
+            glm::mat4 const& view_proj,
+            glm::vec3 eye);
+
+  // draw the faces of a pass of every chunk that survived cull with a single
+  // indirect call, the pipeline of the pass has to be bound already
+  void draw(vk::CommandBuffer command, gsl::index frame, MeshPass pass) const;
+
+  struct CullStats {
+    long long visible;
+    long long total;
+  };
+
+  // chunks drawn out of the chunks with faces, as of the last time cull
+  // recorded into the current frame, max_in_flight frames ago
+  CullStats get_cull_stats() const noexcept { return cull_stats_; }
+
+  struct CompactionStats {
+    long long compactions;
+    long long holes_reclaimed;
+  };
+
+  // hot meshes compacted and empty face slots removed from their draw
+  // ranges since the start
+  CompactionStats get_compaction_stats() const noexcept
+  {
+    return compaction_stats_;
+  }
+
+  // faces held by the chunk buffers right now
+  long long count_faces() const noexcept;
+
+  // what the buffers of the world take, per memory type
+  std::vector<BufferManager::Stats> get_memory_stats() const
+  {
+    return buffer_manager_.get_stats();
+  }
+
+  // the buffer every chunk is pulled from, empty without vertex pulling
+  Buffer get_face_buffer() const noexcept;
+
+  // chunk infos, draw commands and draw count of a frame, in binding order
+  std::array<Buffer, 3> get_cull_buffers(gsl::index frame) const noexcept
+  {
+    return {chunk_infos_[frame], draw_commands_[frame], draw_counts_[frame]};
+  }
 private:
-  void place_block_help(int i,
-                        int j,
-                        BlockType block,
-                        FaceType face,
-                        glm::ivec3 pos);
-  void destroy_block_help(int i, int j, FaceType face, glm::ivec3 pos);
-
-  void
-  create_face(int i, int j, BlockType block, FaceType face, glm::ivec3 pos);
-  void create_face(Buffer& buffer,
-                   HashMap<unsigned, unsigned>& map,
-                   Vector<unsigned>& free,
-                   BlockType block,
-                   FaceType face,
-                   glm::ivec3 pos);
-
-  void destroy_face(int i, int j, FaceType face, glm::ivec3 pos);
-  void destroy_face(Buffer& buffer,
-                    HashMap<unsigned, unsigned>& map,
-                    Vector<unsigned>& free,
-                    FaceType face,
-                    glm::ivec3 pos);
+  void request_chunk(glm::ivec2 offset);
+
+  // chunks are stored modulo side_ in both directions, so moving the view
+  // reuses the slots of the row it leaves and nothing else
+  gsl::index get_slot(glm::ivec2 offset) const noexcept
+  {
+    auto const wrap{[this](int x) { return (x % side_ + side_) % side_; }};
+    return side_ * wrap(offset.x) + wrap(offset.y);
+  }
+
+  bool in_view(glm::ivec2 offset) const noexcept
+  {
+    return offset.x >= offset_.x && offset.x < offset_.x + side_
+        && offset.y >= offset_.y && offset.y < offset_.y + side_;
+  }
+
+  // an edit may touch the faces of the chunks next to it
+  bool is_editable(glm::ivec2 offset) const noexcept
+  {
+    return in_view(offset - glm::ivec2{1, 1})
+        && in_view(offset + glm::ivec2{1, 1});
+  }
+
+  // the chunk holding a world position and the position inside that chunk
+  static std::pair<glm::ivec2, glm::ivec3> locate(glm::ivec3 pos) noexcept
+  {
+    auto const floor_div{[](int a, int b) { return a / b - (a % b < 0); }};
+    glm::ivec2 const chunk{floor_div(pos.x, chunk_width),
+                           floor_div(pos.z, chunk_depth)};
+    return {chunk,
+            {pos.x - chunk.x * chunk_width,
+             pos.y,
+             pos.z - chunk.y * chunk_depth}};
+  }
+
+  // air above and below the world and outside the view
+  BlockType get_block(glm::ivec3 pos);
+
+  // the voxels of a chunk in view, generated on first use
+  HotChunk& get_hot_chunk(glm::ivec2 offset);
+
+  // drop the least recently used voxels until they fit in hot_memory_cap_,
+  // their meshes stay as they are, call it before taking any HotChunk&, a
+  // chunk with unsent faces is kept until they are uploaded
+  void evict_hot_chunks();
+
+  // the edited blocks of a chunk, including those of its border columns
+  // that belong to the chunks after it
+  Vector<BlockMod> find_mods(glm::ivec2 offset) const;
+
+  std::pair<int, int> get_chunk_heights(glm::ivec2 offset) const;
+
+  // write the mesh of a chunk that is not hot to faces, returns the faces of
+  // each pass
+  static PassCounts create_cold_mesh(glm::ivec2 offset,
+                                     std::span<BlockMod const> mods,
+                                     bool greedy,
+                                     std::span<Face> faces);
+
+  // set a block and the copies of it in the border of the chunks before,
+  // then mark the sections whose faces it changes
+  void set_block(glm::ivec2 chunk, glm::ivec3 pos, BlockType block);
+
+  void remesh(glm::ivec2 offset, HotChunk& chunk);
+
+  // replace the mesh of a chunk with one laid out section by section, in a
+  // range with room for all of its faces
+  void lay_out_sections(glm::ivec2 offset, HotChunk& chunk);
+
+  // give the range of a chunk back to the block once no frame draws it
+  void free_mesh(gsl::index slot);
+
+  // keep the frames drawing the mesh of a slot as it is, its edits go
+  // through the staging ring and may wait there for room
+  void hold(gsl::index slot);
+
+  // draw the current mesh of a slot again, the held one is retired
+  void show(gsl::index slot);
+
+  // free a range once no frame in flight draws it
+  void retire(Buffer const& buffer);
+
+  // hand the unsent faces of a hot mesh in a host visible chunk buffer to the
+  // frames after this one, without touching the mesh the frames in flight
+  // draw, the others go with the next upload
+  void publish(glm::ivec2 offset, HotChunk& chunk);
+
+  // record the copies of the unsent faces of chunks through range, which
+  // holds them all
+  void send(vk::CommandBuffer command,
+            Buffer const& range,
+            std::span<std::pair<glm::ivec2, HotChunk*> const> chunks);
+
+  std::list<std::pair<glm::ivec2, HotChunk>>::iterator
+  erase_hot_chunk(std::list<std::pair<glm::ivec2, HotChunk>>::iterator it);
+
+  // slide the cold meshes together to make room for a larger range, the
+  // copies are recorded into command
+  void defragment(vk::CommandBuffer command);
+
+  // a range of the chunk block going from the transfer queue family to the
+  // graphics one, the caller sets the access masks of its half
+  static vk::BufferMemoryBarrier get_ownership_transfer(Buffer const& buffer);
+
+  // empty face slots in the draw range of a hot chunk
+  long long count_holes(glm::ivec2 offset, HotChunk const& chunk) const;
+
+  // slide the sections of a hot mesh down over its holes, shrinking the draw
+  // range, returns the holes removed, the mesh has to hold the opaque faces
+  // alone and lay_out_later adds the others back
+  long long compact(glm::ivec2 offset, HotChunk& chunk);
+
+  // append the cutout and water faces of a hot chunk to the opaque sections
+  // in its mesh, they are sent again if changed or if the sections grew or
+  // shrank
+  void lay_out_later(glm::ivec2 offset, HotChunk& chunk, bool changed);
 
   int side_{};
   glm::ivec2 offset_{};
+  bool greedy_meshing_{};
 
   BufferManager buffer_manager_{};
 
+  // the block every chunk mesh is a range of
+  vk::Buffer face_buffer_{};
+  vk::MemoryPropertyFlags chunk_memory_{};
+  // the range of each chunk slot, empty until its mesh arrives
   std::vector<Buffer> buffers_{};
+  // the faces of each pass in the range of each chunk slot
+  std::vector<PassCounts> pass_counts_{};
+  // the range and faces the frames draw instead for a slot whose edits have
+  // yet to be copied
+  std::vector<std::optional<std::pair<Buffer, PassCounts>>> shown_{};
+  // the ranges given up and the last frame that may have drawn each
+  std::vector<std::pair<Buffer, long long>> retired_{};
+  // frames culled so far
+  long long frame_count_{};
+  // the meshes uploaded on the transfer queue family that the graphics one
+  // has yet to take over
+  std::vector<Buffer> released_{};
+  // an upload ran out of room, and the frame that last made room
+  bool defragment_pending_{};
+  long long defragmented_{-max_in_flight};
+  // the ticket of the mesh each cold chunk is waiting for, 0 if none
+  std::vector<unsigned> tickets_{};
+  unsigned next_ticket_{1};
+  // a streamed mesh failed, only the first failure is printed
+  bool stream_failed_{};
+  // the y range of each chunk slot, bounds its box for culling
+  std::vector<std::pair<int, int>> heights_{};
+
+  std::array<Buffer, max_in_flight> chunk_infos_{};
+  std::array<Buffer, max_in_flight> draw_commands_{};
+  std::array<Buffer, max_in_flight> draw_counts_{};
+  std::array<Buffer, max_in_flight> count_readbacks_{};
+  std::array<long long, max_in_flight> cull_totals_{};
+  CullStats cull_stats_{};
+  CompactionStats compaction_stats_{};
   // std::array<Buffer, 2>* hot_buffers_{};
 
-  std::array<std::array<Terrain, 2>, 2> terrains_{};
-  std::array<std::array<HashMap<unsigned, unsigned>, 2>, 2> maps_{};
-  std::array<std::array<Vector<unsigned>, 2>, 2> free_lists_;
+  // most recently used first, hot_index_ finds a chunk by its offset
+  std::list<std::pair<glm::ivec2, HotChunk>> hot_chunks_{};
+  HashMap<uint64_t, std::list<std::pair<glm::ivec2, HotChunk>>::iterator>
+      hot_index_{};
+  long long hot_memory_cap_{};
+
+  // the blocks of each chunk that differ from the generated terrain, keyed
+  // by get_block_key
+  HashMap<uint64_t, HashMap<unsigned, BlockType>> block_mods_;
 
-  HashMap<uint64_t, Vector<FaceMod>> mods_;
-  HashMap<uint64_t, Vector<BlockMod>> block_mods_;
+  ChunkStreamer streamer_{};
 };